@@ -7,8 +7,12 @@ let package = Package(
     platforms: [.macOS(.v10_13), .iOS(.v11)],
     products: [
         .library(name: "TreeSitterMarkdown", targets: ["TreeSitterMarkdown", "TreeSitterMarkdownInline"]),
+        // The C functions of common/markdown_parser.h, which need the tree-sitter library itself
+        .library(name: "TreeSitterMarkdownParser", targets: ["TreeSitterMarkdownParser"]),
+    ],
+    dependencies: [
+        .package(url: "https://github.com/tree-sitter/tree-sitter", from: "0.22.0"),
     ],
-    dependencies: [],
     targets: [
         .target(name: "TreeSitterMarkdown",
                 path: "tree-sitter-markdown",
@@ -24,7 +28,7 @@ let package = Package(
                     .copy("queries")
                 ],
                 publicHeadersPath: "bindings/swift",
-                cSettings: [.headerSearchPath("src")]),
+                cSettings: [.headerSearchPath("src"), .headerSearchPath("../common")]),
         .target(name: "TreeSitterMarkdownInline",
                 path: "tree-sitter-markdown-inline",
                 exclude: [
@@ -39,6 +43,22 @@ let package = Package(
                     .copy("queries")
                 ],
                 publicHeadersPath: "bindings/swift",
-                cSettings: [.headerSearchPath("src")])
+                cSettings: [.headerSearchPath("src"), .headerSearchPath("../common")]),
+        .target(name: "TreeSitterMarkdownParser",
+                dependencies: [
+                    "TreeSitterMarkdown",
+                    "TreeSitterMarkdownInline",
+                    .product(name: "TreeSitter", package: "tree-sitter"),
+                ],
+                path: "common",
+                exclude: [
+                    "generate-unicode-table.js",
+                    "grammar.js",
+                    "html_entities.json",
+                    "test",
+                ],
+                sources: [
+                    "markdown_parser.cc",
+                ])
     ]
 )
@@ -0,0 +1,452 @@
+//! A deterministic generator for synthetic markdown documents of any size.
+//!
+//! Every construct the generator knows is named after the node type it produces in
+//! `node-types.json`, and a [`Mix`] assigns each of them a weight. The same seed, mix and size
+//! always produce the same bytes, so generated documents can be compared across commits without
+//! checking them in.
+
+use std::io::{self, Write};
+
+use tree_sitter_md::{NODE_TYPES_BLOCK, NODE_TYPES_INLINE};
+
+/// Block constructs and their default weights.
+const BLOCKS: &[(&str, u32)] = &[
+    ("paragraph", 40),
+    ("atx_heading", 6),
+    ("thematic_break", 1),
+    ("fenced_code_block", 6),
+    ("indented_code_block", 2),
+    ("html_block", 2),
+    ("pipe_table", 3),
+    ("block_quote", 4),
+    ("list", 8),
+];
+
+/// Inline constructs and their default weights.
+const INLINES: &[(&str, u32)] = &[
+    ("emphasis", 4),
+    ("strong_emphasis", 3),
+    ("code_span", 3),
+    ("strikethrough", 1),
+    ("inline_link", 2),
+];
+
+const WORDS: &[&str] = &[
+    "the", "parser", "block", "inline", "tree", "node", "edit", "range", "scanner", "token",
+    "markdown", "document", "list", "quote", "table", "code", "fence", "html", "link", "text", "a",
+    "of", "and", "to", "is", "in", "it", "that", "for", "with", "on", "as", "by", "this",
+];
+
+const LANGUAGES: &[&str] = &["rust", "c", "js", "python", "sh", ""];
+
+/// The relative frequency of each construct in a generated document.
+#[derive(Debug, Clone)]
+pub struct Mix {
+    blocks: Vec<(&'static str, u32)>,
+    inlines: Vec<(&'static str, u32)>,
+    /// How deep `block_quote` and `list` may nest.
+    pub depth: usize,
+    /// The fraction of words that are wrapped in an inline construct.
+    pub density: f64,
+}
+
+impl Default for Mix {
+    fn default() -> Self {
+        Mix {
+            blocks: BLOCKS.to_vec(),
+            inlines: INLINES.to_vec(),
+            depth: 3,
+            density: 0.1,
+        }
+    }
+}
+
+impl Mix {
+    /// Parses a comma separated list of `key=value` pairs on top of the default mix.
+    ///
+    /// A key is either the name of a construct, whose value is its weight, or `depth` or
+    /// `density`. For example `pipe_table=20,html_block=0,depth=1`.
+    pub fn parse(spec: &str) -> Result<Mix, String> {
+        let mut mix = Mix::default();
+        for pair in spec.split(',').filter(|pair| !pair.is_empty()) {
+            let (key, value) = match pair.find('=') {
+                Some(i) => (&pair[..i], &pair[i + 1..]),
+                None => return Err(format!("expected key=value, got {}", pair)),
+            };
+            let invalid = || format!("invalid value for {}: {}", key, value);
+            match key {
+                "depth" => mix.depth = value.parse().map_err(|_| invalid())?,
+                "density" => mix.density = value.parse().map_err(|_| invalid())?,
+                _ => {
+                    let weight = value.parse().map_err(|_| invalid())?;
+                    let slot = mix
+                        .blocks
+                        .iter_mut()
+                        .chain(mix.inlines.iter_mut())
+                        .find(|(name, _)| *name == key);
+                    match slot {
+                        Some((_, w)) => *w = weight,
+                        None if is_node_type(key) => {
+                            return Err(format!("node type {} can not be generated", key))
+                        }
+                        None => return Err(format!("unknown node type {}", key)),
+                    }
+                }
+            }
+        }
+        if !mix
+            .blocks
+            .iter()
+            .any(|&(name, w)| w > 0 && name != "block_quote" && name != "list")
+        {
+            return Err("at least one leaf block needs a weight".to_string());
+        }
+        Ok(mix)
+    }
+}
+
+fn is_node_type(name: &str) -> bool {
+    let pattern = format!("\"type\": \"{}\"", name);
+    NODE_TYPES_BLOCK.contains(&pattern) || NODE_TYPES_INLINE.contains(&pattern)
+}
+
+/// xorshift64*, so that output does not depend on the platform or on a crate version.
+struct Rng(u64);
+
+impl Rng {
+    fn new(seed: u64) -> Self {
+        // splitmix64 to spread small seeds over the whole state, which must not be zero
+        let mut z = seed.wrapping_add(0x9e37_79b9_7f4a_7c15);
+        z = (z ^ (z >> 30)).wrapping_mul(0xbf58_476d_1ce4_e5b9);
+        z = (z ^ (z >> 27)).wrapping_mul(0x94d0_49bb_1331_11eb);
+        Rng((z ^ (z >> 31)) | 1)
+    }
+
+    fn next(&mut self) -> u64 {
+        self.0 ^= self.0 >> 12;
+        self.0 ^= self.0 << 25;
+        self.0 ^= self.0 >> 27;
+        self.0.wrapping_mul(0x2545_f491_4f6c_dd1d)
+    }
+
+    /// A number in `low..=high`.
+    fn range(&mut self, low: usize, high: usize) -> usize {
+        low + (self.next() % (high - low + 1) as u64) as usize
+    }
+
+    fn chance(&mut self, p: f64) -> bool {
+        ((self.next() >> 11) as f64) < p * (1u64 << 53) as f64
+    }
+
+    fn pick<'a, T>(&mut self, items: &'a [T]) -> &'a T {
+        &items[self.range(0, items.len() - 1)]
+    }
+
+    fn weighted(&mut self, items: &[(&'static str, u32)]) -> Option<&'static str> {
+        let total: u64 = items.iter().map(|&(_, w)| w as u64).sum();
+        if total == 0 {
+            return None;
+        }
+        let mut n = self.next() % total;
+        for &(name, w) in items {
+            if n < w as u64 {
+                return Some(name);
+            }
+            n -= w as u64;
+        }
+        unreachable!()
+    }
+}
+
+pub struct Generator {
+    rng: Rng,
+    mix: Mix,
+}
+
+impl Generator {
+    pub fn new(seed: u64, mix: Mix) -> Self {
+        Generator {
+            rng: Rng::new(seed),
+            mix,
+        }
+    }
+
+    /// Writes top level blocks to `out` until at least `size` bytes have been written.
+    ///
+    /// Blocks are written one at a time, so documents larger than memory can be streamed to a
+    /// file.
+    pub fn write_document<W: Write>(&mut self, size: usize, out: &mut W) -> io::Result<usize> {
+        let mut written = 0;
+        let mut block = Vec::new();
+        while written < size {
+            block.clear();
+            self.block(0, &mut block);
+            block.push(b'\n');
+            out.write_all(&block)?;
+            written += block.len();
+        }
+        Ok(written)
+    }
+
+    pub fn document(&mut self, size: usize) -> Vec<u8> {
+        let mut out = Vec::with_capacity(size + 1024);
+        self.write_document(size, &mut out).unwrap();
+        out
+    }
+
+    /// Appends one block, ending in a newline, to `out`.
+    fn block(&mut self, depth: usize, out: &mut Vec<u8>) {
+        let kind = loop {
+            let kind = self.rng.weighted(&self.mix.blocks).unwrap();
+            if depth < self.mix.depth || (kind != "block_quote" && kind != "list") {
+                break kind;
+            }
+        };
+        match kind {
+            "paragraph" => {
+                let lines = self.rng.range(1, 4);
+                for _ in 0..lines {
+                    self.line(out);
+                }
+            }
+            "atx_heading" => {
+                let level = self.rng.range(1, 6);
+                out.extend(std::iter::repeat(b'#').take(level));
+                out.push(b' ');
+                self.inline(2, 6, out);
+                out.push(b'\n');
+            }
+            "thematic_break" => {
+                let marker = *self.rng.pick(&["---", "***", "___", "- - -"]);
+                out.extend_from_slice(marker.as_bytes());
+                out.push(b'\n');
+            }
+            "fenced_code_block" => {
+                let fence = *self.rng.pick(&["```", "~~~", "````"]);
+                out.extend_from_slice(fence.as_bytes());
+                out.extend_from_slice(self.rng.pick(LANGUAGES).as_bytes());
+                out.push(b'\n');
+                for _ in 0..self.rng.range(1, 12) {
+                    self.code_line(out);
+                }
+                out.extend_from_slice(fence.as_bytes());
+                out.push(b'\n');
+            }
+            "indented_code_block" => {
+                for _ in 0..self.rng.range(1, 6) {
+                    out.extend_from_slice(b"    ");
+                    self.code_line(out);
+                }
+            }
+            "html_block" => {
+                let tag = *self.rng.pick(&["div", "details", "table", "section"]);
+                writeln!(out, "<{} class=\"{}\">", tag, self.rng.pick(WORDS)).unwrap();
+                for _ in 0..self.rng.range(1, 4) {
+                    out.extend_from_slice(b"  <p>");
+                    self.words(3, 10, out);
+                    out.extend_from_slice(b"</p>\n");
+                }
+                writeln!(out, "</{}>", tag).unwrap();
+            }
+            "pipe_table" => {
+                let columns = self.rng.range(2, 6);
+                self.table_row(columns, out);
+                for _ in 0..columns {
+                    let cell = *self.rng.pick(&["---", ":--", "--:", ":-:"]);
+                    write!(out, "| {} ", cell).unwrap();
+                }
+                out.extend_from_slice(b"|\n");
+                for _ in 0..self.rng.range(1, 20) {
+                    self.table_row(columns, out);
+                }
+            }
+            "block_quote" => {
+                let mut content = Vec::new();
+                self.container_content(depth, &mut content);
+                prefix_lines(&content, b"> ", b"> ", out);
+            }
+            "list" => {
+                let ordered = self.rng.chance(0.3);
+                let marker = *self.rng.pick(if ordered {
+                    &["1.", "1)"]
+                } else {
+                    &["-", "*", "+"]
+                });
+                let tight = self.rng.chance(0.5);
+                let mut content = Vec::new();
+                for i in 0..self.rng.range(1, 8) {
+                    content.clear();
+                    self.container_content(depth, &mut content);
+                    if i > 0 && !tight {
+                        out.push(b'\n');
+                    }
+                    let first = format!("{} ", marker);
+                    let rest = " ".repeat(first.len());
+                    prefix_lines(&content, first.as_bytes(), rest.as_bytes(), out);
+                }
+            }
+            _ => unreachable!("no generator for {}", kind),
+        }
+    }
+
+    /// One to three blocks, separated by blank lines, for the inside of a container.
+    fn container_content(&mut self, depth: usize, out: &mut Vec<u8>) {
+        for i in 0..self.rng.range(1, 3) {
+            if i > 0 {
+                out.push(b'\n');
+            }
+            self.block(depth + 1, out);
+        }
+    }
+
+    fn line(&mut self, out: &mut Vec<u8>) {
+        self.inline(4, 14, out);
+        out.push(b'\n');
+    }
+
+    fn code_line(&mut self, out: &mut Vec<u8>) {
+        out.extend(std::iter::repeat(b' ').take(self.rng.range(0, 3) * 4));
+        let name = *self.rng.pick(WORDS);
+        match self.rng.range(0, 3) {
+            0 => writeln!(
+                out,
+                "let {} = {}({});",
+                name,
+                self.rng.pick(WORDS),
+                self.rng.next() % 100
+            ),
+            1 => writeln!(
+                out,
+                "if ({} < {}) {{ return *{}; }}",
+                name,
+                self.rng.next() % 10,
+                name
+            ),
+            2 => writeln!(
+                out,
+                "// {} {} `{}`",
+                name,
+                self.rng.pick(WORDS),
+                self.rng.pick(WORDS)
+            ),
+            _ => writeln!(out, "{}[{}] = \"<{}>\";", name, self.rng.next() % 8, name),
+        }
+        .unwrap();
+    }
+
+    fn table_row(&mut self, columns: usize, out: &mut Vec<u8>) {
+        for _ in 0..columns {
+            out.extend_from_slice(b"| ");
+            self.inline(1, 3, out);
+            out.push(b' ');
+        }
+        out.extend_from_slice(b"|\n");
+    }
+
+    /// Between `min` and `max` words, with `density` of them wrapped in an inline construct.
+    fn inline(&mut self, min: usize, max: usize, out: &mut Vec<u8>) {
+        for i in 0..self.rng.range(min, max) {
+            if i > 0 {
+                out.push(b' ');
+            }
+            let word = *self.rng.pick(WORDS);
+            let construct = if self.rng.chance(self.mix.density) {
+                self.rng.weighted(&self.mix.inlines)
+            } else {
+                None
+            };
+            match construct {
+                None => out.extend_from_slice(word.as_bytes()),
+                Some("emphasis") => write!(out, "*{}*", word).unwrap(),
+                Some("strong_emphasis") => write!(out, "**{}**", word).unwrap(),
+                Some("code_span") => write!(out, "`{}`", word).unwrap(),
+                Some("strikethrough") => write!(out, "~~{}~~", word).unwrap(),
+                Some("inline_link") => {
+                    write!(out, "[{}](https://example.com/{})", word, word).unwrap()
+                }
+                Some(kind) => unreachable!("no generator for {}", kind),
+            }
+        }
+    }
+
+    fn words(&mut self, min: usize, max: usize, out: &mut Vec<u8>) {
+        for i in 0..self.rng.range(min, max) {
+            if i > 0 {
+                out.push(b' ');
+            }
+            out.extend_from_slice(self.rng.pick(WORDS).as_bytes());
+        }
+    }
+}
+
+/// Copies `content` to `out` with `first` in front of its first line and `rest` in front of all
+/// other non-blank lines.
+fn prefix_lines(content: &[u8], first: &[u8], rest: &[u8], out: &mut Vec<u8>) {
+    for (i, line) in content.split_inclusive(|&b| b == b'\n').enumerate() {
+        if i == 0 {
+            out.extend_from_slice(first);
+        } else if line != b"\n" {
+            out.extend_from_slice(rest);
+        } else if rest.starts_with(b">") {
+            out.push(b'>');
+        }
+        out.extend_from_slice(line);
+    }
+}
+
+/// Parses a size like `512`, `64K`, `16M` or `1G`, with binary multiples.
+pub fn parse_size(size: &str) -> Result<usize, String> {
+    let (digits, multiplier) = match size.as_bytes().last() {
+        Some(b'K') | Some(b'k') => (&size[..size.len() - 1], 1 << 10),
+        Some(b'M') | Some(b'm') => (&size[..size.len() - 1], 1 << 20),
+        Some(b'G') | Some(b'g') => (&size[..size.len() - 1], 1 << 30),
+        _ => (size, 1),
+    };
+    digits
+        .parse::<usize>()
+        .map(|n| n * multiplier)
+        .map_err(|_| format!("invalid size {}", size))
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn constructs_are_node_types() {
+        for &(name, _) in BLOCKS {
+            assert!(
+                NODE_TYPES_BLOCK.contains(&format!("\"type\": \"{}\"", name)),
+                "{}",
+                name
+            );
+        }
+        for &(name, _) in INLINES {
+            assert!(
+                NODE_TYPES_INLINE.contains(&format!("\"type\": \"{}\"", name)),
+                "{}",
+                name
+            );
+        }
+    }
+
+    #[test]
+    fn output_is_deterministic() {
+        let a = Generator::new(7, Mix::default()).document(64 << 10);
+        let b = Generator::new(7, Mix::default()).document(64 << 10);
+        let c = Generator::new(8, Mix::default()).document(64 << 10);
+        assert!(a.len() >= 64 << 10);
+        assert_eq!(a, b);
+        assert_ne!(a, c);
+    }
+
+    #[test]
+    fn parse_mix() {
+        let mix = Mix::parse("pipe_table=20,depth=1,density=0.5").unwrap();
+        assert_eq!(mix.depth, 1);
+        assert_eq!(mix.density, 0.5);
+        assert!(mix.blocks.contains(&("pipe_table", 20)));
+        assert!(Mix::parse("setext_heading=1").is_err());
+        assert!(Mix::parse("no_such_node=1").is_err());
+    }
+}
@@ -0,0 +1,183 @@
+//! Timing and reporting shared by all benchmark modes.
+
+use std::time::{Duration, Instant};
+
+use tree_sitter_md::MemoryUsage;
+
+/// How often each benchmark is run.
+#[derive(Debug, Clone, Copy)]
+pub struct Config {
+    /// Runs whose timings are thrown away before measuring.
+    pub warmup: usize,
+    /// Runs that are measured.
+    pub iterations: usize,
+}
+
+impl Default for Config {
+    fn default() -> Self {
+        Config {
+            warmup: 2,
+            iterations: 10,
+        }
+    }
+}
+
+/// The timings of all measured runs of one benchmark.
+#[derive(Debug, Clone)]
+pub struct Samples {
+    samples: Vec<Duration>,
+}
+
+impl Samples {
+    pub fn new(mut samples: Vec<Duration>) -> Self {
+        assert!(!samples.is_empty(), "A benchmark needs at least one sample");
+        samples.sort();
+        Samples { samples }
+    }
+
+    pub fn min(&self) -> Duration {
+        self.samples[0]
+    }
+
+    pub fn max(&self) -> Duration {
+        self.samples[self.samples.len() - 1]
+    }
+
+    pub fn median(&self) -> Duration {
+        self.percentile(50.0)
+    }
+
+    /// Nearest-rank percentile, `p` in `0.0..=100.0`.
+    pub fn percentile(&self, p: f64) -> Duration {
+        let rank = (p / 100.0 * self.samples.len() as f64).ceil() as usize;
+        self.samples[rank.clamp(1, self.samples.len()) - 1]
+    }
+
+    /// Throughput in MB/s (10^6 bytes) for `bytes` processed per run, based on the median.
+    ///
+    /// The median is used instead of the mean so that a single run that was descheduled does not
+    /// move the result.
+    pub fn throughput(&self, bytes: usize) -> f64 {
+        bytes as f64 / self.median().as_secs_f64() / 1e6
+    }
+}
+
+/// Run `setup` and then time `routine` on its result, `config.warmup + config.iterations` times.
+///
+/// Only `routine` is timed, so `setup` can prepare per-run state like an edited copy of a tree.
+pub fn measure<S, R, T>(config: &Config, mut setup: S, mut routine: R) -> Samples
+where
+    S: FnMut() -> T,
+    R: FnMut(T),
+{
+    let mut samples = Vec::with_capacity(config.iterations);
+    for i in 0..config.warmup + config.iterations {
+        let input = setup();
+        let start = Instant::now();
+        routine(input);
+        let elapsed = start.elapsed();
+        if i >= config.warmup {
+            samples.push(elapsed);
+        }
+    }
+    Samples::new(samples)
+}
+
+/// Restarts the measurement of [`peak_memory`].
+///
+/// On Linux this resets the peak resident set size of the process by writing to
+/// `/proc/self/clear_refs`. Elsewhere it does nothing.
+pub fn reset_peak_memory() {
+    if cfg!(target_os = "linux") {
+        let _ = std::fs::write("/proc/self/clear_refs", "5");
+    }
+}
+
+/// The peak resident set size of the process in bytes since the last [`reset_peak_memory`], read
+/// from `VmHWM` in `/proc/self/status`. `None` where that is not available.
+pub fn peak_memory() -> Option<u64> {
+    let status = std::fs::read_to_string("/proc/self/status").ok()?;
+    let line = status.lines().find(|line| line.starts_with("VmHWM:"))?;
+    let kilobytes: u64 = line["VmHWM:".len()..]
+        .trim()
+        .trim_end_matches("kB")
+        .trim()
+        .parse()
+        .ok()?;
+    Some(kilobytes * 1024)
+}
+
+/// Prints one row per benchmark in a fixed column layout, so the output of two runs can be
+/// compared with `diff`.
+pub struct Report;
+
+impl Report {
+    pub fn header() {
+        println!(
+            "{:<16} {:<14} {:>10} {:>12} {:>12} {:>10}",
+            "corpus", "benchmark", "bytes", "median", "min", "MB/s"
+        );
+    }
+
+    pub fn row(corpus: &str, benchmark: &str, bytes: usize, samples: &Samples) {
+        println!(
+            "{:<16} {:<14} {:>10} {:>12} {:>12} {:>10.2}",
+            corpus,
+            benchmark,
+            bytes,
+            format_duration(samples.median()),
+            format_duration(samples.min()),
+            samples.throughput(bytes)
+        );
+    }
+
+    pub fn latency_header() {
+        println!(
+            "{:<32} {:>8} {:>12} {:>12} {:>12}",
+            "trace", "edits", "p50", "p99", "max"
+        );
+    }
+
+    pub fn latency_row(trace: &str, edits: usize, samples: &Samples) {
+        println!(
+            "{:<32} {:>8} {:>12} {:>12} {:>12}",
+            trace,
+            edits,
+            format_duration(samples.median()),
+            format_duration(samples.percentile(99.0)),
+            format_duration(samples.max())
+        );
+    }
+
+    pub fn memory_header() {
+        println!(
+            "{:<16} {:>10} {:>12} {:>12} {:>12} {:>12} {:>12} {:>8}",
+            "corpus", "bytes", "block", "inline", "indices", "states", "total", "ratio"
+        );
+    }
+
+    pub fn memory_row(corpus: &str, bytes: usize, usage: &MemoryUsage) {
+        println!(
+            "{:<16} {:>10} {:>12} {:>12} {:>12} {:>12} {:>12} {:>8.2}",
+            corpus,
+            bytes,
+            usage.block_tree,
+            usage.inline_trees,
+            usage.inline_indices,
+            usage.scanner_states,
+            usage.total(),
+            usage.total() as f64 / bytes.max(1) as f64
+        );
+    }
+}
+
+pub fn format_duration(duration: Duration) -> String {
+    let micros = duration.as_secs_f64() * 1e6;
+    if micros < 1000.0 {
+        format!("{:.1}us", micros)
+    } else if micros < 1e6 {
+        format!("{:.3}ms", micros / 1e3)
+    } else {
+        format!("{:.3}s", micros / 1e6)
+    }
+}
@@ -1,21 +1,415 @@
+//! Benchmarks for the markdown parser.
+//!
+//! Usage: `benchmark [--bench NAME]... [--iterations N] [--warmup N] [--generate SIZE]...
+//! [--seed N] [--mix SPEC] [--emit] [--replay TRACE]... [--scanner-stats] [--memory]
+//! [--json FILE] [--baseline FILE] [--threshold PERCENT] [--trace DIR] [FILE]...`
+//!
+//! Without files or `--generate` all `*.md` files in `benchmark/corpus` are used. Every input is
+//! run through each of the benchmarks in [`BENCHMARKS`], or through those selected with `--bench`.
+//!
+//! `--generate` adds a synthetic document of the given size (like `64K` or `1G`), built from
+//! `--seed` and `--mix` as described in [`generate::Mix::parse`]. With `--emit` the generated
+//! documents are written to stdout instead of being benchmarked.
+//!
+//! `--replay` replays a recorded editing session, see [`replay`], and reports the latency of the
+//! reparse after each edit instead. The traces in `benchmark/traces` are examples.
+//!
+//! `--scanner-stats` prints the counters of the external scanners for one full parse of each
+//! input after its benchmarks. This needs the `scanner-stats` feature.
+//!
+//! `--trace` writes a Chrome trace of one full parse of each input to `DIR/NAME.json`, see
+//! [`trace`]. This needs the `trace` feature.
+//!
+//! `--memory` prints the memory used by the tree of each input, as estimated by
+//! [`MarkdownTree::memory_usage`], after all benchmarks.
+//!
+//! `--json` writes the results to a file in the format described in [`results`]. `--baseline`
+//! compares them to a file written that way by an earlier run and exits with status 1 if the
+//! throughput of any benchmark dropped, or its peak memory grew, by more than `--threshold`
+//! percent (5 by default).
+
+mod generate;
+mod harness;
+mod replay;
+mod results;
+
+use std::path::{Path, PathBuf};
+
+use generate::{Generator, Mix};
+use harness::{measure, peak_memory, reset_peak_memory, Config, Report, Samples};
+use replay::{Edit, Trace};
+use results::Record;
+use tree_sitter::{Parser, Query, QueryCursor, Range, Tree};
 use tree_sitter_md::*;
 
+const CORPUS_DIR: &str = concat!(env!("CARGO_MANIFEST_DIR"), "/benchmark/corpus");
+
+/// The names of all benchmarks in the order they are run.
+const BENCHMARKS: &[&str] = &[
+    "full",
+    "block",
+    "inline",
+    "edit-start",
+    "edit-middle",
+    "edit-end",
+];
+
 fn main() {
-    let mut parser = MarkdownParser::default();
-    let filename = std::env::args().nth(1).unwrap();
-    let source = std::fs::read(filename).unwrap();
-    let mut tree = parser.parse(&source, None).unwrap();
-    tree.edit(&tree_sitter::InputEdit {
-        start_byte: 0,
-        old_end_byte: 1,
-        new_end_byte: 0,
-        start_position: tree_sitter::Point::new(0, 0),
-        old_end_position: tree_sitter::Point::new(0, 1),
-        new_end_position: tree_sitter::Point::new(0, 0),
+    let mut config = Config::default();
+    let mut selected = Vec::new();
+    let mut files = Vec::new();
+    let mut sizes = Vec::new();
+    let mut seed = 0;
+    let mut mix = Mix::default();
+    let mut emit = false;
+    let mut traces = Vec::new();
+    let mut scanner_stats = false;
+    let mut trace_dir = None;
+    let mut memory = false;
+    let mut json = None;
+    let mut baseline = None;
+    let mut threshold = 5.0;
+    let mut args = std::env::args().skip(1);
+    while let Some(arg) = args.next() {
+        match arg.as_str() {
+            "--bench" => selected.push(expect_value(&arg, args.next())),
+            "--iterations" => config.iterations = expect_number(&arg, args.next()),
+            "--warmup" => config.warmup = expect_number(&arg, args.next()),
+            "--generate" => sizes.push(
+                generate::parse_size(&expect_value(&arg, args.next()))
+                    .unwrap_or_else(|err| usage(&err)),
+            ),
+            "--seed" => seed = expect_number(&arg, args.next()) as u64,
+            "--mix" => {
+                mix = Mix::parse(&expect_value(&arg, args.next())).unwrap_or_else(|err| usage(&err))
+            }
+            "--emit" => emit = true,
+            "--replay" => traces.push(PathBuf::from(expect_value(&arg, args.next()))),
+            "--scanner-stats" if cfg!(feature = "scanner-stats") => scanner_stats = true,
+            "--scanner-stats" => usage("--scanner-stats needs the scanner-stats feature"),
+            "--trace" if cfg!(feature = "trace") => {
+                trace_dir = Some(PathBuf::from(expect_value(&arg, args.next())))
+            }
+            "--trace" => usage("--trace needs the trace feature"),
+            "--memory" => memory = true,
+            "--json" => json = Some(PathBuf::from(expect_value(&arg, args.next()))),
+            "--baseline" => baseline = Some(PathBuf::from(expect_value(&arg, args.next()))),
+            "--threshold" => {
+                let value = expect_value(&arg, args.next());
+                threshold = value
+                    .parse()
+                    .ok()
+                    .filter(|&threshold: &f64| threshold >= 0.0)
+                    .unwrap_or_else(|| {
+                        usage(&format!("--threshold needs a percentage, got {}", value))
+                    })
+            }
+            _ if arg.starts_with("--") => usage(&format!("unknown option {}", arg)),
+            _ => files.push(PathBuf::from(arg)),
+        }
+    }
+    for name in &selected {
+        if !BENCHMARKS.contains(&name.as_str()) {
+            usage(&format!("unknown benchmark {}", name));
+        }
+    }
+    if config.iterations == 0 {
+        usage("--iterations must be at least 1");
+    }
+    // Read the baseline first, so a typo in its path does not waste a whole run
+    let baseline = baseline.map(|path| {
+        let json = std::fs::read_to_string(&path)
+            .unwrap_or_else(|err| usage(&format!("Could not read {}: {}", path.display(), err)));
+        results::from_json(&json)
+            .unwrap_or_else(|err| usage(&format!("{}: {}", path.display(), err)))
     });
-    reparse(&mut parser, &source[1..], tree);
+    if emit {
+        let stdout = std::io::stdout();
+        let mut out = std::io::BufWriter::new(stdout.lock());
+        for &size in &sizes {
+            Generator::new(seed, mix.clone())
+                .write_document(size, &mut out)
+                .expect("Could not write to stdout");
+        }
+        return;
+    }
+    if !traces.is_empty() {
+        Report::latency_header();
+        for path in &traces {
+            let trace = Trace::load(path).unwrap_or_else(|err| usage(&err));
+            let samples = replay::replay(&trace, &config);
+            Report::latency_row(&path.display().to_string(), trace.edits.len(), &samples);
+        }
+        if files.is_empty() && sizes.is_empty() {
+            return;
+        }
+        println!();
+    }
+    if files.is_empty() && sizes.is_empty() {
+        files = corpus_files(Path::new(CORPUS_DIR));
+    }
+
+    let inputs = files
+        .into_iter()
+        .map(Input::File)
+        .chain(sizes.into_iter().map(Input::Generated));
+    let mut memory_usage = Vec::new();
+    let mut records = Vec::new();
+    Report::header();
+    for input in inputs {
+        let (corpus, source) = input.load(seed, &mix);
+        if memory {
+            let tree = MarkdownParser::default().parse(&source, None).unwrap();
+            memory_usage.push((corpus.clone(), source.len(), tree.memory_usage()));
+        }
+        for name in BENCHMARKS {
+            if selected.is_empty() || selected.iter().any(|s| s == name) {
+                reset_peak_memory();
+                let samples = run(name, &source, &config);
+                Report::row(&corpus, name, source.len(), &samples);
+                records.push(Record::new(
+                    &corpus,
+                    name,
+                    source.len(),
+                    &samples,
+                    peak_memory(),
+                ));
+            }
+        }
+        if scanner_stats {
+            print_scanner_stats(&source);
+        }
+        if let Some(dir) = &trace_dir {
+            write_trace(&source, &dir.join(format!("{}.json", corpus)));
+        }
+    }
+    if !memory_usage.is_empty() {
+        println!();
+        Report::memory_header();
+        for (corpus, bytes, usage) in &memory_usage {
+            Report::memory_row(corpus, *bytes, usage);
+        }
+    }
+    if let Some(path) = json {
+        std::fs::write(&path, results::to_json(&records))
+            .unwrap_or_else(|err| panic!("Could not write {}: {}", path.display(), err));
+    }
+    if let Some(baseline) = baseline {
+        println!();
+        if results::compare(&baseline, &records, threshold) {
+            eprintln!("error: performance regressed by more than {}%", threshold);
+            std::process::exit(1);
+        }
+    }
+}
+
+#[cfg(feature = "scanner-stats")]
+fn print_scanner_stats(source: &[u8]) {
+    stats::reset();
+    MarkdownParser::default().parse(source, None).unwrap();
+    println!("\n{}", stats::report());
+}
+
+#[cfg(not(feature = "scanner-stats"))]
+fn print_scanner_stats(_source: &[u8]) {
+    unreachable!()
+}
+
+/// Scans that take longer than this get their own span in traces
+#[cfg(feature = "trace")]
+const SLOW_SCAN: std::time::Duration = std::time::Duration::from_micros(5);
+
+#[cfg(feature = "trace")]
+fn write_trace(source: &[u8], path: &Path) {
+    trace::start(SLOW_SCAN);
+    MarkdownParser::default().parse(source, None).unwrap();
+    let json = trace::stop().to_json();
+    std::fs::write(path, json)
+        .unwrap_or_else(|err| panic!("Could not write {}: {}", path.display(), err));
+}
+
+#[cfg(not(feature = "trace"))]
+fn write_trace(_source: &[u8], _path: &Path) {
+    unreachable!()
+}
+
+enum Input {
+    File(PathBuf),
+    Generated(usize),
+}
+
+impl Input {
+    /// Returns the name shown in the report and the content.
+    fn load(self, seed: u64, mix: &Mix) -> (String, Vec<u8>) {
+        match self {
+            Input::File(path) => {
+                let source = std::fs::read(&path)
+                    .unwrap_or_else(|err| panic!("Could not read {}: {}", path.display(), err));
+                let name = path.file_name().map_or_else(
+                    || path.display().to_string(),
+                    |name| name.to_string_lossy().into_owned(),
+                );
+                (name, source)
+            }
+            Input::Generated(size) => {
+                let source = Generator::new(seed, mix.clone()).document(size);
+                (format!("generated-{}", size), source)
+            }
+        }
+    }
+}
+
+fn run(name: &str, source: &[u8], config: &Config) -> Samples {
+    match name {
+        "full" => bench_full(source, config),
+        "block" => bench_block(source, config),
+        "inline" => bench_inline(source, config),
+        "edit-start" => bench_edit(source, 0, config),
+        "edit-middle" => bench_edit(source, char_boundary(source, source.len() / 2), config),
+        "edit-end" => bench_edit(source, source.len(), config),
+        _ => unreachable!(),
+    }
+}
+
+/// Both passes, the way an editor parses a newly opened document.
+fn bench_full(source: &[u8], config: &Config) -> Samples {
+    let mut parser = MarkdownParser::default();
+    measure(
+        config,
+        || (),
+        |()| {
+            parser.parse(source, None).unwrap();
+        },
+    )
+}
+
+/// Only the block grammar.
+fn bench_block(source: &[u8], config: &Config) -> Samples {
+    let mut parser = Parser::new();
+    parser.set_language(language()).unwrap();
+    measure(
+        config,
+        || (),
+        |()| {
+            parser.parse(source, None).unwrap();
+        },
+    )
+}
+
+/// Only the inline grammar, on the inline ranges of a block tree that is parsed once up front.
+fn bench_inline(source: &[u8], config: &Config) -> Samples {
+    let mut parser = Parser::new();
+    parser.set_language(language()).unwrap();
+    let block_tree = parser.parse(source, None).unwrap();
+    let ranges = inline_ranges(&block_tree, source);
+    parser.set_language(inline_language()).unwrap();
+    measure(
+        config,
+        || (),
+        |()| {
+            for ranges in &ranges {
+                parser.set_included_ranges(ranges).unwrap();
+                parser.parse(source, None).unwrap();
+            }
+        },
+    )
+}
+
+/// Reparse after typing a single character at `offset`.
+///
+/// Each run edits a fresh copy of the same old tree, so every run does the same work.
+fn bench_edit(source: &[u8], offset: usize, config: &Config) -> Samples {
+    let mut parser = MarkdownParser::default();
+    let old_tree = parser.parse(source, None).unwrap();
+    let mut edited = source.to_vec();
+    let edit = Edit {
+        start: offset,
+        deleted: 0,
+        inserted: b"x".to_vec(),
+    }
+    .apply(&mut edited);
+    measure(
+        config,
+        || {
+            let mut tree = old_tree.clone();
+            tree.edit(&edit);
+            tree
+        },
+        |tree| {
+            parser.parse(&edited, Some(&tree)).unwrap();
+        },
+    )
+}
+
+/// The included ranges for each `inline` node, computed the same way as in
+/// [`MarkdownParser::parse`].
+fn inline_ranges(block_tree: &Tree, source: &[u8]) -> Vec<Vec<Range>> {
+    let query = Query::new(language(), INLINE_INJECTION_QUERY).unwrap();
+    let mut query_cursor = QueryCursor::new();
+    let mut tree_cursor = block_tree.walk();
+    let mut result = Vec::new();
+    for capture in query_cursor
+        .matches(&query, block_tree.root_node(), source)
+        .flat_map(|query_match| query_match.captures)
+    {
+        let mut range = capture.node.range();
+        let mut ranges = Vec::new();
+        for child in capture.node.named_children(&mut tree_cursor) {
+            let child_range = child.range();
+            ranges.push(Range {
+                start_byte: range.start_byte,
+                start_point: range.start_point,
+                end_byte: child_range.start_byte,
+                end_point: child_range.start_point,
+            });
+            range.start_byte = child_range.end_byte;
+            range.start_point = child_range.end_point;
+        }
+        ranges.push(range);
+        result.push(ranges);
+    }
+    result
+}
+
+/// Moves `offset` back to the start of a UTF-8 sequence.
+fn char_boundary(source: &[u8], mut offset: usize) -> usize {
+    while offset > 0 && offset < source.len() && source[offset] & 0xc0 == 0x80 {
+        offset -= 1;
+    }
+    offset
+}
+
+fn corpus_files(dir: &Path) -> Vec<PathBuf> {
+    let entries = std::fs::read_dir(dir)
+        .unwrap_or_else(|err| panic!("Could not read {}: {}", dir.display(), err));
+    let mut files: Vec<PathBuf> = entries
+        .map(|entry| entry.unwrap().path())
+        .filter(|path| path.extension().map_or(false, |ext| ext == "md"))
+        .collect();
+    files.sort();
+    files
+}
+
+fn expect_value(option: &str, value: Option<String>) -> String {
+    value.unwrap_or_else(|| usage(&format!("{} needs a value", option)))
+}
+
+fn expect_number(option: &str, value: Option<String>) -> usize {
+    let value = expect_value(option, value);
+    value
+        .parse()
+        .unwrap_or_else(|_| usage(&format!("{} needs a number, got {}", option, value)))
 }
 
-fn reparse(parser: &mut MarkdownParser, source: &[u8], old_tree: MarkdownTree) {
-    parser.parse(source, Some(&old_tree));
+fn usage(message: &str) -> ! {
+    eprintln!("error: {}", message);
+    eprintln!(
+        "usage: benchmark [--bench NAME]... [--iterations N] [--warmup N] [--generate SIZE]...\n\
+         \x20                [--seed N] [--mix SPEC] [--emit] [--replay TRACE]...\n\
+         \x20                [--scanner-stats] [--memory] [--json FILE] [--baseline FILE]\n\
+         \x20                [--threshold PERCENT] [--trace DIR] [FILE]...\n\
+         benchmarks: {}",
+        BENCHMARKS.join(", ")
+    );
+    std::process::exit(2);
 }
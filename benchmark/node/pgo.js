@@ -0,0 +1,51 @@
+// Builds the node addon with profile guided optimization and link time optimization.
+//
+//     node benchmark/node/pgo.js
+//
+// 1. Builds an instrumented addon with `TREE_SITTER_MARKDOWN_PGO=generate`.
+// 2. Runs `benchmark/node/train.js` with it, which writes the profile to `.pgo`.
+// 3. With clang, merges the raw profiles into `.pgo/default.profdata` with `llvm-profdata`
+//    (or `$LLVM_PROFDATA`). GCC reads its profiles as they are.
+// 4. Rebuilds the addon with `TREE_SITTER_MARKDOWN_PGO=use`, which also enables LTO.
+//
+// The profile is only valid for the sources it was recorded with, so all steps have to run again
+// after any change to a grammar or scanner.
+
+const { execFileSync } = require('child_process');
+const fs = require('fs');
+const path = require('path');
+
+const ROOT = path.join(__dirname, '..', '..');
+const PROFILE_DIR = path.join(ROOT, '.pgo');
+// npm passes the path of its own node-gyp to scripts
+const NODE_GYP = process.env.npm_config_node_gyp || require.resolve('node-gyp/bin/node-gyp.js');
+
+function run(command, args, pgo) {
+    console.log(`> ${[command, ...args].join(' ')}`);
+    execFileSync(command, args, {
+        cwd: ROOT,
+        stdio: 'inherit',
+        env: {
+            ...process.env,
+            TREE_SITTER_MARKDOWN_PGO: pgo || '',
+            TREE_SITTER_MARKDOWN_PROFILE_DIR: PROFILE_DIR,
+        },
+    });
+}
+
+fs.rmSync(PROFILE_DIR, { recursive: true, force: true });
+fs.mkdirSync(PROFILE_DIR, { recursive: true });
+
+run(process.execPath, [NODE_GYP, 'rebuild'], 'generate');
+run(process.execPath, [path.join(__dirname, 'train.js'), '3'], 'generate');
+
+const raw_profiles = fs.readdirSync(PROFILE_DIR).filter((name) => name.endsWith('.profraw'));
+if (raw_profiles.length > 0) {
+    run(process.env.LLVM_PROFDATA || 'llvm-profdata', [
+        'merge',
+        `--output=${path.join(PROFILE_DIR, 'default.profdata')}`,
+        ...raw_profiles.map((name) => path.join(PROFILE_DIR, name)),
+    ]);
+}
+
+run(process.execPath, [NODE_GYP, 'rebuild'], 'use');
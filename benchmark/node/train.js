@@ -0,0 +1,79 @@
+// Parses every file in `benchmark/corpus` with the node binding and prints the throughput.
+//
+// This is the training run of the profile guided build in `benchmark/node/pgo.js`, and also how
+// the optimized addon is compared with a normal build:
+//
+//     node benchmark/node/train.js [ITERATIONS]
+//
+// Each file is parsed from scratch, then reparsed after an edit in its middle, and the whole
+// corpus is parsed once more through `parseBatch`, so that the profile covers all of the paths
+// that users of the binding take.
+
+const fs = require('fs');
+const path = require('path');
+const { MarkdownParser, parseBatch } = require('../../bindings/node');
+
+const CORPUS = path.join(__dirname, '..', 'corpus');
+
+function point(text, index) {
+    const before = text.subarray(0, index).toString();
+    const lines = before.split('\n');
+    return { row: lines.length - 1, column: Buffer.byteLength(lines[lines.length - 1]) };
+}
+
+// Inserts a space in the middle of `text` and returns the new text and the edit
+function edit(text) {
+    const index = text.indexOf('\n', text.length >> 1) + 1;
+    const position = point(text, index);
+    const edited = Buffer.concat([text.subarray(0, index), Buffer.from(' '), text.subarray(index)]);
+    return {
+        text: edited,
+        edit: {
+            startIndex: index,
+            oldEndIndex: index,
+            newEndIndex: index + 1,
+            startPosition: position,
+            oldEndPosition: position,
+            newEndPosition: { row: position.row, column: position.column + 1 },
+        },
+    };
+}
+
+async function main() {
+    const iterations = Number(process.argv[2] || 10);
+    const files = fs.readdirSync(CORPUS)
+        .filter((name) => name.endsWith('.md'))
+        .map((name) => path.join(CORPUS, name));
+    const parser = new MarkdownParser();
+
+    let total_bytes = 0;
+    let total_time = 0n;
+    console.log(`${'corpus'.padEnd(16)} ${'full MB/s'.padStart(10)} ${'edit MB/s'.padStart(10)}`);
+    for (const file of files) {
+        const text = fs.readFileSync(file);
+        const edited = edit(text);
+        let full = 0n;
+        let reparse = 0n;
+        for (let i = 0; i < iterations; i++) {
+            let start = process.hrtime.bigint();
+            const tree = parser.parse(text);
+            full += process.hrtime.bigint() - start;
+            tree.edit(edited.edit);
+            start = process.hrtime.bigint();
+            parser.parse(edited.text, tree);
+            reparse += process.hrtime.bigint() - start;
+        }
+        total_bytes += text.length * iterations;
+        total_time += full;
+        const throughput = (time) => (text.length * iterations / (Number(time) / 1e9) / 1e6).toFixed(2);
+        console.log(`${path.basename(file).padEnd(16)} ${throughput(full).padStart(10)} ${throughput(reparse).padStart(10)}`);
+    }
+    console.log(`${'total'.padEnd(16)} ${(total_bytes / (Number(total_time) / 1e9) / 1e6).toFixed(2).padStart(10)}`);
+
+    await parseBatch(files, { flat: true });
+}
+
+main().catch((error) => {
+    console.error(error);
+    process.exit(1);
+});
@@ -0,0 +1,47 @@
+#!/bin/sh
+# Builds the benchmark with cross-language ThinLTO and profile guided optimization, and compares
+# it with a normal release build.
+#
+#     benchmark/pgo.sh [BENCHMARK OPTION]...
+#
+# 1. Runs the normal release build and writes its results to target/pgo/baseline.json.
+# 2. Builds an instrumented benchmark, C, C++ and Rust alike, and runs it over the corpus to
+#    record a profile in target/pgo/profiles.
+# 3. Merges the profile with llvm-profdata and builds the optimized benchmark.
+# 4. Runs the optimized benchmark with `--baseline`, which prints the change in throughput.
+#
+# Needs clang and lld of the same LLVM version as rustc, and llvm-profdata from the
+# llvm-tools-preview component of rustup (or LLVM_PROFDATA). The options are passed to every run
+# of the benchmark, e.g. `--iterations 20`.
+#
+# The C and C++ code is built with the TREE_SITTER_MARKDOWN_LTO, _PGO and _PROFILE options of
+# build.rs, the Rust code with RUSTFLAGS. No gain of this build has been measured yet; put the
+# output of a run in any pull request that proposes to use it by default.
+set -eu
+
+cd "$(dirname "$0")/.."
+PGO_DIR="$PWD/target/pgo"
+LTO_FLAGS="-Clinker-plugin-lto -Clinker=clang -Clink-arg=-fuse-ld=lld"
+LLVM_PROFDATA=${LLVM_PROFDATA:-$(find "$(rustc --print sysroot)" -name llvm-profdata -type f | head -n 1)}
+if [ -z "$LLVM_PROFDATA" ]; then
+    echo "llvm-profdata not found, run rustup component add llvm-tools-preview" >&2
+    exit 1
+fi
+
+rm -rf "$PGO_DIR"
+mkdir -p "$PGO_DIR/profiles"
+
+cargo run --release --bin benchmark -- "$@" --json "$PGO_DIR/baseline.json"
+
+export TREE_SITTER_MARKDOWN_LTO=1
+
+TREE_SITTER_MARKDOWN_PGO=generate TREE_SITTER_MARKDOWN_PROFILE="$PGO_DIR/profiles" \
+RUSTFLAGS="$LTO_FLAGS -Cprofile-generate=$PGO_DIR/profiles" \
+    cargo run --release --bin benchmark --target-dir "$PGO_DIR/target-generate" -- "$@"
+
+"$LLVM_PROFDATA" merge -o "$PGO_DIR/merged.profdata" "$PGO_DIR/profiles"
+
+TREE_SITTER_MARKDOWN_PGO=use TREE_SITTER_MARKDOWN_PROFILE="$PGO_DIR/merged.profdata" \
+RUSTFLAGS="$LTO_FLAGS -Cprofile-use=$PGO_DIR/merged.profdata" \
+    cargo run --release --bin benchmark --target-dir "$PGO_DIR/target-use" -- "$@" \
+    --baseline "$PGO_DIR/baseline.json" --json "$PGO_DIR/optimized.json"
@@ -0,0 +1,206 @@
+//! Replays recorded editing sessions to measure the latency of incremental reparses.
+//!
+//! A trace is a text file with one command per line. Empty lines and lines starting with `#` are
+//! ignored.
+//!
+//! * `document PATH` The starting document, relative to the trace. Must come first.
+//! * `insert OFFSET TEXT` Insert `TEXT` at byte `OFFSET`.
+//! * `delete OFFSET LENGTH` Delete `LENGTH` bytes starting at byte `OFFSET`.
+//! * `replace OFFSET LENGTH TEXT` Replace `LENGTH` bytes starting at byte `OFFSET` with `TEXT`.
+//!
+//! `TEXT` is the rest of the line, in which `\n`, `\t`, `\s` (a space) and `\\` are escapes.
+
+use std::path::Path;
+use std::time::Instant;
+
+use tree_sitter::{InputEdit, Point};
+use tree_sitter_md::MarkdownParser;
+
+use crate::harness::{Config, Samples};
+
+/// One change to a document.
+#[derive(Debug, Clone)]
+pub struct Edit {
+    pub start: usize,
+    pub deleted: usize,
+    pub inserted: Vec<u8>,
+}
+
+impl Edit {
+    /// Applies the edit to `source` and returns the [`InputEdit`] that describes it.
+    pub fn apply(&self, source: &mut Vec<u8>) -> InputEdit {
+        let start_position = point_at(source, self.start);
+        let old_end_position = point_at(source, self.start + self.deleted);
+        let new_end_position = match self.inserted.iter().rposition(|&b| b == b'\n') {
+            Some(i) => Point::new(
+                start_position.row + self.inserted.iter().filter(|&&b| b == b'\n').count(),
+                self.inserted.len() - i - 1,
+            ),
+            None => Point::new(
+                start_position.row,
+                start_position.column + self.inserted.len(),
+            ),
+        };
+        source.splice(
+            self.start..self.start + self.deleted,
+            self.inserted.iter().copied(),
+        );
+        InputEdit {
+            start_byte: self.start,
+            old_end_byte: self.start + self.deleted,
+            new_end_byte: self.start + self.inserted.len(),
+            start_position,
+            old_end_position,
+            new_end_position,
+        }
+    }
+}
+
+fn point_at(source: &[u8], offset: usize) -> Point {
+    let before = &source[..offset];
+    let row = before.iter().filter(|&&b| b == b'\n').count();
+    let line_start = before
+        .iter()
+        .rposition(|&b| b == b'\n')
+        .map_or(0, |i| i + 1);
+    Point::new(row, offset - line_start)
+}
+
+pub struct Trace {
+    pub document: Vec<u8>,
+    pub edits: Vec<Edit>,
+}
+
+impl Trace {
+    pub fn load(path: &Path) -> Result<Trace, String> {
+        let content = std::fs::read_to_string(path)
+            .map_err(|err| format!("Could not read {}: {}", path.display(), err))?;
+        let mut document = None;
+        let mut edits = Vec::new();
+        let mut len = 0;
+        for (i, line) in content.lines().enumerate() {
+            let error = |message: &str| format!("{}:{}: {}", path.display(), i + 1, message);
+            if line.is_empty() || line.starts_with('#') {
+                continue;
+            }
+            let mut parts = line.splitn(2, ' ');
+            let command = parts.next().unwrap();
+            let rest = parts.next().unwrap_or("");
+            if command == "document" {
+                let file = path.parent().unwrap_or_else(|| Path::new(".")).join(rest);
+                let source = std::fs::read(&file)
+                    .map_err(|err| error(&format!("Could not read {}: {}", file.display(), err)))?;
+                len = source.len();
+                document = Some(source);
+                continue;
+            }
+            if document.is_none() {
+                return Err(error("expected document first"));
+            }
+            let (start, rest) = number(rest).ok_or_else(|| error("expected an offset"))?;
+            let (deleted, inserted) = match command {
+                "insert" => (0, unescape(rest)),
+                "delete" => (
+                    number(rest).ok_or_else(|| error("expected a length"))?.0,
+                    vec![],
+                ),
+                "replace" => {
+                    let (deleted, rest) = number(rest).ok_or_else(|| error("expected a length"))?;
+                    (deleted, unescape(rest))
+                }
+                _ => return Err(error(&format!("unknown command {}", command))),
+            };
+            if start + deleted > len {
+                return Err(error("edit is past the end of the document"));
+            }
+            len = len - deleted + inserted.len();
+            edits.push(Edit {
+                start,
+                deleted,
+                inserted,
+            });
+        }
+        let document = document.ok_or_else(|| format!("{}: no document", path.display()))?;
+        Ok(Trace { document, edits })
+    }
+}
+
+/// Parses a number followed by a space or the end of `s`, and returns it with the rest of `s`.
+fn number(s: &str) -> Option<(usize, &str)> {
+    let end = s.find(' ').unwrap_or_else(|| s.len());
+    let n = s[..end].parse().ok()?;
+    Some((n, s.get(end + 1..).unwrap_or("")))
+}
+
+fn unescape(s: &str) -> Vec<u8> {
+    let mut result = Vec::with_capacity(s.len());
+    let mut bytes = s.bytes();
+    while let Some(b) = bytes.next() {
+        if b != b'\\' {
+            result.push(b);
+            continue;
+        }
+        match bytes.next() {
+            Some(b'n') => result.push(b'\n'),
+            Some(b't') => result.push(b'\t'),
+            Some(b's') => result.push(b' '),
+            Some(other) => result.push(other),
+            None => result.push(b'\\'),
+        }
+    }
+    result
+}
+
+/// Replays `trace` `config.warmup + config.iterations` times and returns the latency of each
+/// reparse in the measured replays.
+///
+/// Only `MarkdownParser::parse` is timed. Applying the edit to the text and to the old tree is
+/// not.
+pub fn replay(trace: &Trace, config: &Config) -> Samples {
+    let mut parser = MarkdownParser::default();
+    let mut samples = Vec::with_capacity(config.iterations * trace.edits.len());
+    for i in 0..config.warmup + config.iterations {
+        let mut source = trace.document.clone();
+        let mut tree = parser.parse(&source, None).unwrap();
+        for edit in &trace.edits {
+            tree.edit(&edit.apply(&mut source));
+            let start = Instant::now();
+            tree = parser.parse(&source, Some(&tree)).unwrap();
+            let elapsed = start.elapsed();
+            if i >= config.warmup {
+                samples.push(elapsed);
+            }
+        }
+    }
+    Samples::new(samples)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn traces_are_valid() {
+        let dir = Path::new(env!("CARGO_MANIFEST_DIR")).join("benchmark/traces");
+        for entry in std::fs::read_dir(dir).unwrap() {
+            let path = entry.unwrap().path();
+            let trace = Trace::load(&path).unwrap();
+            assert!(!trace.edits.is_empty(), "{}", path.display());
+        }
+    }
+
+    #[test]
+    fn apply_edit() {
+        let mut source = b"# a\n\nb c\n".to_vec();
+        let edit = Edit {
+            start: 6,
+            deleted: 2,
+            inserted: b"x\nyz".to_vec(),
+        }
+        .apply(&mut source);
+        assert_eq!(source, b"# a\n\nbx\nyz\n");
+        assert_eq!(edit.start_position, Point::new(2, 1));
+        assert_eq!(edit.old_end_position, Point::new(2, 3));
+        assert_eq!(edit.new_end_position, Point::new(3, 2));
+    }
+}
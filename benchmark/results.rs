@@ -0,0 +1,361 @@
+//! Machine readable results and the comparison of a run against a baseline.
+//!
+//! Results are written as a JSON array with one object per input and benchmark:
+//!
+//! ```json
+//! [
+//!   {"corpus": "spec.md", "benchmark": "full", "bytes": 211430, "median_ns": 41803112,
+//!    "min_ns": 41512086, "throughput": 5.06, "peak_memory": 25358336}
+//! ]
+//! ```
+//!
+//! `throughput` is in MB/s, `peak_memory` is the peak resident set size of the whole process
+//! in bytes while the benchmark ran, or `null` where it can not be measured. Only this format
+//! needs to be read back, so the parser below knows no more JSON than that.
+
+use std::fmt::Write;
+
+use crate::harness::Samples;
+
+#[derive(Debug, Clone, PartialEq)]
+pub struct Record {
+    pub corpus: String,
+    pub benchmark: String,
+    pub bytes: usize,
+    pub median_ns: u64,
+    pub min_ns: u64,
+    pub throughput: f64,
+    pub peak_memory: Option<u64>,
+}
+
+impl Record {
+    pub fn new(
+        corpus: &str,
+        benchmark: &str,
+        bytes: usize,
+        samples: &Samples,
+        peak_memory: Option<u64>,
+    ) -> Self {
+        Record {
+            corpus: corpus.to_string(),
+            benchmark: benchmark.to_string(),
+            bytes,
+            median_ns: samples.median().as_nanos() as u64,
+            min_ns: samples.min().as_nanos() as u64,
+            throughput: samples.throughput(bytes),
+            peak_memory,
+        }
+    }
+}
+
+pub fn to_json(records: &[Record]) -> String {
+    let mut out = String::from("[\n");
+    for (i, record) in records.iter().enumerate() {
+        write!(
+            out,
+            "  {{\"corpus\": {}, \"benchmark\": {}, \"bytes\": {}, \"median_ns\": {}, \
+             \"min_ns\": {}, \"throughput\": {:.4}, \"peak_memory\": {}}}",
+            quote(&record.corpus),
+            quote(&record.benchmark),
+            record.bytes,
+            record.median_ns,
+            record.min_ns,
+            record.throughput,
+            record
+                .peak_memory
+                .map_or_else(|| "null".to_string(), |peak| peak.to_string())
+        )
+        .unwrap();
+        out.push_str(if i + 1 < records.len() { ",\n" } else { "\n" });
+    }
+    out.push_str("]\n");
+    out
+}
+
+fn quote(s: &str) -> String {
+    let mut result = String::with_capacity(s.len() + 2);
+    result.push('"');
+    for c in s.chars() {
+        match c {
+            '"' => result.push_str("\\\""),
+            '\\' => result.push_str("\\\\"),
+            '\n' => result.push_str("\\n"),
+            c if (c as u32) < 0x20 => write!(result, "\\u{:04x}", c as u32).unwrap(),
+            c => result.push(c),
+        }
+    }
+    result.push('"');
+    result
+}
+
+pub fn from_json(json: &str) -> Result<Vec<Record>, String> {
+    let mut parser = JsonParser {
+        input: json.as_bytes(),
+        position: 0,
+    };
+    let mut records = Vec::new();
+    parser.expect(b'[')?;
+    if !parser.eat(b']') {
+        loop {
+            records.push(parser.record()?);
+            if parser.eat(b']') {
+                break;
+            }
+            parser.expect(b',')?;
+        }
+    }
+    parser.skip_whitespace();
+    if parser.position != parser.input.len() {
+        return Err(parser.error("expected the end of the file"));
+    }
+    Ok(records)
+}
+
+struct JsonParser<'a> {
+    input: &'a [u8],
+    position: usize,
+}
+
+impl JsonParser<'_> {
+    fn error(&self, message: &str) -> String {
+        format!("{} at byte {}", message, self.position)
+    }
+
+    fn skip_whitespace(&mut self) {
+        while self.position < self.input.len() && self.input[self.position].is_ascii_whitespace() {
+            self.position += 1;
+        }
+    }
+
+    fn eat(&mut self, c: u8) -> bool {
+        self.skip_whitespace();
+        if self.input.get(self.position) == Some(&c) {
+            self.position += 1;
+            true
+        } else {
+            false
+        }
+    }
+
+    fn expect(&mut self, c: u8) -> Result<(), String> {
+        if self.eat(c) {
+            Ok(())
+        } else {
+            Err(self.error(&format!("expected '{}'", c as char)))
+        }
+    }
+
+    fn record(&mut self) -> Result<Record, String> {
+        let mut record = Record {
+            corpus: String::new(),
+            benchmark: String::new(),
+            bytes: 0,
+            median_ns: 0,
+            min_ns: 0,
+            throughput: 0.0,
+            peak_memory: None,
+        };
+        self.expect(b'{')?;
+        if self.eat(b'}') {
+            return Err(self.error("empty record"));
+        }
+        loop {
+            let key = self.string()?;
+            self.expect(b':')?;
+            match key.as_str() {
+                "corpus" => record.corpus = self.string()?,
+                "benchmark" => record.benchmark = self.string()?,
+                "bytes" => record.bytes = self.number()? as usize,
+                "median_ns" => record.median_ns = self.number()? as u64,
+                "min_ns" => record.min_ns = self.number()? as u64,
+                "throughput" => record.throughput = self.number()?,
+                "peak_memory" => record.peak_memory = self.null_or_number()?.map(|n| n as u64),
+                _ => return Err(self.error(&format!("unknown key {}", key))),
+            }
+            if self.eat(b'}') {
+                return Ok(record);
+            }
+            self.expect(b',')?;
+        }
+    }
+
+    fn string(&mut self) -> Result<String, String> {
+        self.expect(b'"')?;
+        let mut bytes = Vec::new();
+        loop {
+            let c = *self
+                .input
+                .get(self.position)
+                .ok_or_else(|| self.error("unterminated string"))?;
+            self.position += 1;
+            match c {
+                b'"' => break,
+                b'\\' => {
+                    let escape = *self
+                        .input
+                        .get(self.position)
+                        .ok_or_else(|| self.error("unterminated string"))?;
+                    self.position += 1;
+                    match escape {
+                        b'n' => bytes.push(b'\n'),
+                        b't' => bytes.push(b'\t'),
+                        b'u' => {
+                            let code = self
+                                .input
+                                .get(self.position..self.position + 4)
+                                .and_then(|hex| std::str::from_utf8(hex).ok())
+                                .and_then(|hex| u32::from_str_radix(hex, 16).ok())
+                                .and_then(std::char::from_u32)
+                                .ok_or_else(|| self.error("invalid \\u escape"))?;
+                            self.position += 4;
+                            let mut buffer = [0; 4];
+                            bytes.extend_from_slice(code.encode_utf8(&mut buffer).as_bytes());
+                        }
+                        other => bytes.push(other),
+                    }
+                }
+                c => bytes.push(c),
+            }
+        }
+        String::from_utf8(bytes).map_err(|_| self.error("invalid UTF-8 in string"))
+    }
+
+    fn number(&mut self) -> Result<f64, String> {
+        self.skip_whitespace();
+        let start = self.position;
+        while self.position < self.input.len()
+            && matches!(
+                self.input[self.position],
+                b'0'..=b'9' | b'-' | b'+' | b'.' | b'e' | b'E'
+            )
+        {
+            self.position += 1;
+        }
+        std::str::from_utf8(&self.input[start..self.position])
+            .unwrap()
+            .parse()
+            .map_err(|_| self.error("expected a number"))
+    }
+
+    fn null_or_number(&mut self) -> Result<Option<f64>, String> {
+        self.skip_whitespace();
+        if self.input[self.position..].starts_with(b"null") {
+            self.position += 4;
+            Ok(None)
+        } else {
+            self.number().map(Some)
+        }
+    }
+}
+
+/// How a result compares to the baseline.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Verdict {
+    Ok,
+    Regressed,
+    /// The baseline has no result for this input and benchmark.
+    New,
+}
+
+/// Compares each record of `current` with the record for the same input and benchmark in
+/// `baseline`, prints the result and returns whether anything regressed.
+///
+/// A record regresses if its throughput dropped, or its peak memory grew, by more than
+/// `threshold` percent.
+pub fn compare(baseline: &[Record], current: &[Record], threshold: f64) -> bool {
+    println!(
+        "{:<16} {:<14} {:>10} {:>10} {:>8} {:>12} {:>12} {:>8}  {}",
+        "corpus", "benchmark", "base MB/s", "MB/s", "change", "base peak", "peak", "change", ""
+    );
+    let mut regressed = false;
+    for record in current {
+        let base = baseline
+            .iter()
+            .find(|base| base.corpus == record.corpus && base.benchmark == record.benchmark);
+        let throughput_change = base.map(|base| change(base.throughput, record.throughput));
+        let memory_change = base
+            .and_then(|base| Some(change(base.peak_memory? as f64, record.peak_memory? as f64)));
+        let verdict = match base {
+            None => Verdict::New,
+            Some(_)
+                if throughput_change.map_or(false, |c| c < -threshold)
+                    || memory_change.map_or(false, |c| c > threshold) =>
+            {
+                Verdict::Regressed
+            }
+            Some(_) => Verdict::Ok,
+        };
+        regressed |= verdict == Verdict::Regressed;
+        println!(
+            "{:<16} {:<14} {:>10} {:>10.2} {:>8} {:>12} {:>12} {:>8}  {}",
+            record.corpus,
+            record.benchmark,
+            base.map_or_else(|| "-".to_string(), |base| format!("{:.2}", base.throughput)),
+            record.throughput,
+            format_change(throughput_change),
+            base.and_then(|base| base.peak_memory)
+                .map_or_else(|| "-".to_string(), |peak| peak.to_string()),
+            record
+                .peak_memory
+                .map_or_else(|| "-".to_string(), |peak| peak.to_string()),
+            format_change(memory_change),
+            match verdict {
+                Verdict::Ok => "",
+                Verdict::Regressed => "REGRESSED",
+                Verdict::New => "new",
+            }
+        );
+    }
+    regressed
+}
+
+/// Relative change from `old` to `new` in percent.
+fn change(old: f64, new: f64) -> f64 {
+    if old == 0.0 {
+        0.0
+    } else {
+        (new - old) / old * 100.0
+    }
+}
+
+fn format_change(change: Option<f64>) -> String {
+    change.map_or_else(|| "-".to_string(), |change| format!("{:+.1}%", change))
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn record(benchmark: &str, throughput: f64, peak_memory: Option<u64>) -> Record {
+        Record {
+            corpus: "a \"quoted\"\\name.md".to_string(),
+            benchmark: benchmark.to_string(),
+            bytes: 1000,
+            median_ns: 2000,
+            min_ns: 1500,
+            throughput,
+            peak_memory,
+        }
+    }
+
+    #[test]
+    fn json_round_trip() {
+        let records = vec![
+            record("full", 12.5, Some(4096)),
+            record("block", 3.25, None),
+        ];
+        assert_eq!(from_json(&to_json(&records)).unwrap(), records);
+        assert_eq!(from_json("[]").unwrap(), vec![]);
+        assert!(from_json("[{\"speed\": 1}]").is_err());
+    }
+
+    #[test]
+    fn detects_regressions() {
+        let baseline = vec![record("full", 10.0, Some(1000))];
+        assert!(!compare(&baseline, &[record("full", 9.7, Some(1020))], 5.0));
+        assert!(compare(&baseline, &[record("full", 9.0, Some(1000))], 5.0));
+        assert!(compare(&baseline, &[record("full", 10.0, Some(1100))], 5.0));
+        assert!(!compare(&baseline, &[record("full", 10.0, None)], 5.0));
+        assert!(!compare(&baseline, &[record("edit-end", 1.0, None)], 5.0));
+    }
+}
@@ -0,0 +1,208 @@
+// Microbenchmark for the routines of the block scanner.
+//
+// Each case is a single line of input together with the `valid_symbols` and the scanner state
+// the block grammar would have at its start. The scanner is restored to that state and driven
+// through its C interface over and over, so the per-call cost of the routine the case reaches
+// can be measured on its own, without a tree-sitter parse around it. Besides the time per call it
+// prints the length of the token that was found and how many bytes the scanner read for it.
+//
+//     make block && ./block [CASE]...
+//
+// Compare against another version of the scanner with
+//
+//     make block BLOCK_SCANNER=path/to/scanner.cc
+#include "mock_lexer.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+extern "C" {
+    void *tree_sitter_markdown_external_scanner_create();
+    bool tree_sitter_markdown_external_scanner_scan(void *, TSLexer *, const bool *);
+    unsigned tree_sitter_markdown_external_scanner_serialize(void *, char *);
+    void tree_sitter_markdown_external_scanner_deserialize(void *, const char *, unsigned);
+    void tree_sitter_markdown_external_scanner_destroy(void *);
+}
+
+// Must match the order of `externals` in tree-sitter-markdown/grammar.js
+enum TokenType {
+    LINE_ENDING,
+    SOFT_LINE_ENDING,
+    BLOCK_CLOSE,
+    BLOCK_CONTINUATION,
+    BLOCK_QUOTE_START,
+    INDENTED_CHUNK_START,
+    ATX_H1_MARKER,
+    ATX_H2_MARKER,
+    ATX_H3_MARKER,
+    ATX_H4_MARKER,
+    ATX_H5_MARKER,
+    ATX_H6_MARKER,
+    SETEXT_H1_UNDERLINE,
+    SETEXT_H2_UNDERLINE,
+    THEMATIC_BREAK,
+    LIST_MARKER_MINUS,
+    LIST_MARKER_PLUS,
+    LIST_MARKER_STAR,
+    LIST_MARKER_PARENTHESIS,
+    LIST_MARKER_DOT,
+    LIST_MARKER_MINUS_DONT_INTERRUPT,
+    LIST_MARKER_PLUS_DONT_INTERRUPT,
+    LIST_MARKER_STAR_DONT_INTERRUPT,
+    LIST_MARKER_PARENTHESIS_DONT_INTERRUPT,
+    LIST_MARKER_DOT_DONT_INTERRUPT,
+    FENCED_CODE_BLOCK_START_BACKTICK,
+    FENCED_CODE_BLOCK_START_TILDE,
+    BLANK_LINE_START,
+    FENCED_CODE_BLOCK_END_BACKTICK,
+    FENCED_CODE_BLOCK_END_TILDE,
+    HTML_BLOCK_1_START,
+    HTML_BLOCK_1_END,
+    HTML_BLOCK_2_START,
+    HTML_BLOCK_3_START,
+    HTML_BLOCK_4_START,
+    HTML_BLOCK_5_START,
+    HTML_BLOCK_6_START,
+    HTML_BLOCK_7_START,
+    CLOSE_BLOCK,
+    NO_INDENTED_CHUNK,
+    ERROR,
+    TRIGGER_ERROR,
+    TOKEN_EOF,
+    MINUS_METADATA,
+    PLUS_METADATA,
+    PIPE_TABLE_START,
+    PIPE_TABLE_LINE_ENDING,
+    TOKEN_COUNT,
+};
+
+// Must match `Block` in tree-sitter-markdown/src/scanner.cc
+enum Block : uint8_t {
+    BLOCK_QUOTE,
+    INDENTED_CODE_BLOCK,
+    LIST_ITEM,
+    LIST_ITEM_1_INDENTATION,
+    LIST_ITEM_2_INDENTATION,
+};
+
+// Must match the state flags in tree-sitter-markdown/src/scanner.cc
+const uint8_t STATE_MATCHING = 0x1 << 0;
+
+// The tokens that are valid at the start of a block outside of a paragraph
+const std::initializer_list<TokenType> BLOCK_START = {
+    BLOCK_QUOTE_START, INDENTED_CHUNK_START, ATX_H1_MARKER, ATX_H2_MARKER, ATX_H3_MARKER,
+    ATX_H4_MARKER, ATX_H5_MARKER, ATX_H6_MARKER, THEMATIC_BREAK, LIST_MARKER_MINUS,
+    LIST_MARKER_PLUS, LIST_MARKER_STAR, LIST_MARKER_PARENTHESIS, LIST_MARKER_DOT,
+    LIST_MARKER_MINUS_DONT_INTERRUPT, LIST_MARKER_PLUS_DONT_INTERRUPT, LIST_MARKER_STAR_DONT_INTERRUPT,
+    LIST_MARKER_PARENTHESIS_DONT_INTERRUPT, LIST_MARKER_DOT_DONT_INTERRUPT,
+    FENCED_CODE_BLOCK_START_BACKTICK, FENCED_CODE_BLOCK_START_TILDE, BLANK_LINE_START,
+    HTML_BLOCK_1_START, HTML_BLOCK_2_START, HTML_BLOCK_3_START, HTML_BLOCK_4_START,
+    HTML_BLOCK_5_START, HTML_BLOCK_6_START, HTML_BLOCK_7_START, PIPE_TABLE_START,
+};
+
+struct Case {
+    // The routine of the scanner this case ends up in
+    const char *routine;
+    const char *name;
+    const char *input;
+    std::vector<TokenType> valid;
+    uint8_t state;
+    std::vector<uint8_t> open_blocks;
+};
+
+Case block_start(const char *routine, const char *name, const char *input, std::initializer_list<TokenType> extra = {}) {
+    Case result = { routine, name, input, BLOCK_START, 0, {} };
+    result.valid.insert(result.valid.end(), extra);
+    return result;
+}
+
+Case matching(const char *name, const char *input, std::vector<uint8_t> open_blocks) {
+    return { "match", name, input, { BLOCK_CONTINUATION, BLOCK_CLOSE }, STATE_MATCHING, open_blocks };
+}
+
+const Case CASES[] = {
+    block_start("parse_star", "star-list-item", "* a list item\n"),
+    block_start("parse_star", "star-thematic-break", "* * * * * * * *\n"),
+    block_start("parse_minus", "minus-list-item", "- a list item\n"),
+    block_start("parse_minus", "minus-thematic-break", "- - - - - - - -\n"),
+    block_start("parse_minus", "minus-metadata", "---\ntitle: a document\ntags: [a, b]\n---\n", { MINUS_METADATA }),
+    block_start("parse_ordered_list_marker", "ordered-dot", "123. a list item\n"),
+    block_start("parse_ordered_list_marker", "ordered-parenthesis", "7) a list item\n"),
+    block_start("parse_html_block", "html-script", "<script type=\"text/javascript\">\n"),
+    block_start("parse_html_block", "html-comment", "<!-- a comment -->\n"),
+    block_start("parse_html_block", "html-div", "<div class=\"note\">\n"),
+    block_start("parse_html_block", "html-custom-tag", "<custom-element data-a=\"1\" data-b='2' hidden>\n"),
+    block_start("parse_html_block", "html-no-block", "<span>inline html</span>\n"),
+    block_start("parse_pipe_table", "pipe-table", "| a | b | c |\n| --- | :-: | --: |\n"),
+    block_start("parse_pipe_table", "pipe-table-wide", "a | b | c | d | e | f | g | h\n-|-|-|-|-|-|-|-\n"),
+    block_start("parse_pipe_table", "no-pipe-table", "just a paragraph of text\n"),
+    matching("block-quotes", "> > > quoted\n", { BLOCK_QUOTE, BLOCK_QUOTE, BLOCK_QUOTE }),
+    matching("list-items", "      nested item\n", { LIST_ITEM, LIST_ITEM, LIST_ITEM }),
+    matching("mixed", ">    >   text\n", { BLOCK_QUOTE, LIST_ITEM_1_INDENTATION, BLOCK_QUOTE, LIST_ITEM }),
+    matching("indented-code", "        code\n", { LIST_ITEM_2_INDENTATION, INDENTED_CODE_BLOCK }),
+};
+
+const char *const TOKEN_NAMES[] = {
+    "LINE_ENDING", "SOFT_LINE_ENDING", "BLOCK_CLOSE", "BLOCK_CONTINUATION", "BLOCK_QUOTE_START",
+    "INDENTED_CHUNK_START", "ATX_H1_MARKER", "ATX_H2_MARKER", "ATX_H3_MARKER", "ATX_H4_MARKER",
+    "ATX_H5_MARKER", "ATX_H6_MARKER", "SETEXT_H1_UNDERLINE", "SETEXT_H2_UNDERLINE",
+    "THEMATIC_BREAK", "LIST_MARKER_MINUS", "LIST_MARKER_PLUS", "LIST_MARKER_STAR",
+    "LIST_MARKER_PARENTHESIS", "LIST_MARKER_DOT", "LIST_MARKER_MINUS_DONT_INTERRUPT",
+    "LIST_MARKER_PLUS_DONT_INTERRUPT", "LIST_MARKER_STAR_DONT_INTERRUPT",
+    "LIST_MARKER_PARENTHESIS_DONT_INTERRUPT", "LIST_MARKER_DOT_DONT_INTERRUPT",
+    "FENCED_CODE_BLOCK_START_BACKTICK", "FENCED_CODE_BLOCK_START_TILDE", "BLANK_LINE_START",
+    "FENCED_CODE_BLOCK_END_BACKTICK", "FENCED_CODE_BLOCK_END_TILDE", "HTML_BLOCK_1_START",
+    "HTML_BLOCK_1_END", "HTML_BLOCK_2_START", "HTML_BLOCK_3_START", "HTML_BLOCK_4_START",
+    "HTML_BLOCK_5_START", "HTML_BLOCK_6_START", "HTML_BLOCK_7_START", "CLOSE_BLOCK",
+    "NO_INDENTED_CHUNK", "ERROR", "TRIGGER_ERROR", "TOKEN_EOF", "MINUS_METADATA", "PLUS_METADATA",
+    "PIPE_TABLE_START", "PIPE_TABLE_LINE_ENDING",
+};
+
+static_assert(sizeof(TOKEN_NAMES) / sizeof(TOKEN_NAMES[0]) == TOKEN_COUNT, "a token is missing a name");
+
+const size_t ITERATIONS = 1000000;
+
+int main(int argc, char **argv) {
+    void *scanner = tree_sitter_markdown_external_scanner_create();
+    printf("%-26s %-22s %10s %6s %6s  %s\n", "routine", "case", "ns/call", "token", "read", "result");
+    for (const Case &c : CASES) {
+        bool selected = argc <= 1;
+        for (int i = 1; i < argc; i++) {
+            selected |= strcmp(argv[i], c.name) == 0 || strcmp(argv[i], c.routine) == 0;
+        }
+        if (!selected) {
+            continue;
+        }
+        bool valid_symbols[TOKEN_COUNT] = {};
+        for (TokenType token : c.valid) {
+            valid_symbols[token] = true;
+        }
+        // The serialized state: flags, matched, indentation, column, fence length, open blocks
+        std::string state = { char(c.state), 0, 0, 0, 0 };
+        state.append(c.open_blocks.begin(), c.open_blocks.end());
+        MockLexer lexer(c.input, strlen(c.input));
+
+        bool result = false;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < ITERATIONS; i++) {
+            tree_sitter_markdown_external_scanner_deserialize(scanner, state.data(), state.size());
+            lexer.reset(0);
+            result = tree_sitter_markdown_external_scanner_scan(scanner, &lexer.lexer, valid_symbols);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        printf(
+            "%-26s %-22s %10.2f %6zu %6zu  %s\n",
+            c.routine,
+            c.name,
+            elapsed.count() * 1e9 / ITERATIONS,
+            lexer.end_of_token(),
+            lexer.position,
+            result ? TOKEN_NAMES[lexer.lexer.result_symbol] : "(none)"
+        );
+    }
+    tree_sitter_markdown_external_scanner_destroy(scanner);
+    return 0;
+}
@@ -0,0 +1,112 @@
+// Microbenchmark for the delimiter run handling of the inline scanner on emphasis-dense text.
+//
+// The scanner is driven directly through its C interface at every '*', '_' and '~' of the
+// input, with the same `valid_symbols` the inline grammar would have there.
+//
+//     make emphasis && ./emphasis
+//
+// Compare against another version of the scanner with
+//
+//     make emphasis INLINE_SCANNER=path/to/scanner.cc
+#include "mock_lexer.h"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+extern "C" {
+    void *tree_sitter_markdown_inline_external_scanner_create();
+    bool tree_sitter_markdown_inline_external_scanner_scan(void *, TSLexer *, const bool *);
+    unsigned tree_sitter_markdown_inline_external_scanner_serialize(void *, char *);
+    void tree_sitter_markdown_inline_external_scanner_deserialize(void *, const char *, unsigned);
+    void tree_sitter_markdown_inline_external_scanner_destroy(void *);
+}
+
+// Must match the order of `externals` in tree-sitter-markdown-inline/grammar.js
+enum TokenType {
+    ERROR,
+    TRIGGER_ERROR,
+    CODE_SPAN_START,
+    CODE_SPAN_CLOSE,
+    EMPHASIS_OPEN_STAR,
+    EMPHASIS_OPEN_UNDERSCORE,
+    EMPHASIS_CLOSE_STAR,
+    EMPHASIS_CLOSE_UNDERSCORE,
+    LAST_TOKEN_WHITESPACE,
+    LAST_TOKEN_PUNCTUATION,
+    STRIKETHROUGH_OPEN,
+    STRIKETHROUGH_CLOSE,
+    TOKEN_COUNT,
+};
+
+struct Corpus {
+    const char *name;
+    const char *pattern;
+};
+
+const Corpus CORPORA[] = {
+    { "emphasis", "Some *emphasis* and **strong emphasis** and _more_ __of it__. " },
+    { "nested", "***a** b* _a __b__ c_ *a _b_ **c***\n" },
+    { "intraword", "snake_case_name foo*bar*baz __init__ a**b**c\n" },
+    { "strikethrough", "~~gone~~ ~a~ ~~*both*~~ x~y~z\n" },
+    { "unmatched", "*a **b _c __d ~e ~~f a* b** c_ d__ e~ f~~\n" },
+    { "cjk", "これは*強調*です。**「太字」**と_下線_、～～削除～～。\n" },
+    { "european", "Ça *marche* — «**très**» bien, n’est-ce pas? „_Ja_“ ¡*sí*!\n" },
+};
+
+const size_t CORPUS_SIZE = 1 << 20;
+const size_t ITERATIONS = 20;
+
+bool is_ascii_punctuation(char c) {
+    return (c >= '!' && c <= '/') || (c >= ':' && c <= '@') || (c >= '[' && c <= '`') || (c >= '{' && c <= '~');
+}
+
+int main() {
+    void *scanner = tree_sitter_markdown_inline_external_scanner_create();
+    char buffer[TREE_SITTER_SERIALIZATION_BUFFER_SIZE];
+    for (const Corpus &corpus : CORPORA) {
+        std::string source;
+        while (source.size() < CORPUS_SIZE) {
+            source += corpus.pattern;
+        }
+        MockLexer lexer(source);
+        size_t calls = 0;
+        size_t tokens = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t iteration = 0; iteration < ITERATIONS; iteration++) {
+            unsigned state_length = 0;
+            for (size_t i = 0; i < source.size(); i++) {
+                char c = source[i];
+                if (c != '*' && c != '_' && c != '~') {
+                    continue;
+                }
+                bool valid_symbols[TOKEN_COUNT] = {};
+                valid_symbols[EMPHASIS_OPEN_STAR] = valid_symbols[EMPHASIS_CLOSE_STAR] = true;
+                valid_symbols[EMPHASIS_OPEN_UNDERSCORE] = valid_symbols[EMPHASIS_CLOSE_UNDERSCORE] = true;
+                valid_symbols[STRIKETHROUGH_OPEN] = valid_symbols[STRIKETHROUGH_CLOSE] = true;
+                char previous = i > 0 ? source[i - 1] : '\n';
+                valid_symbols[LAST_TOKEN_WHITESPACE] = previous == ' ' || previous == '\n';
+                valid_symbols[LAST_TOKEN_PUNCTUATION] = is_ascii_punctuation(previous);
+                tree_sitter_markdown_inline_external_scanner_deserialize(scanner, buffer, state_length);
+                lexer.reset(i);
+                calls++;
+                if (tree_sitter_markdown_inline_external_scanner_scan(scanner, &lexer.lexer, valid_symbols)) {
+                    tokens++;
+                    state_length = tree_sitter_markdown_inline_external_scanner_serialize(scanner, buffer);
+                }
+            }
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        double megabytes = double(source.size() * ITERATIONS) / (1 << 20);
+        printf(
+            "%-14s %8.2f ns/call %8.1f MB/s %10zu calls %10zu tokens\n",
+            corpus.name,
+            elapsed.count() * 1e9 / calls,
+            megabytes / elapsed.count(),
+            calls / ITERATIONS,
+            tokens / ITERATIONS
+        );
+    }
+    tree_sitter_markdown_inline_external_scanner_destroy(scanner);
+    return 0;
+}
@@ -0,0 +1,111 @@
+// An in-memory implementation of `TSLexer` that can be used to drive the external scanners
+// directly, without going through a tree-sitter parse.
+#ifndef TREE_SITTER_MARKDOWN_MOCK_LEXER_H_
+#define TREE_SITTER_MARKDOWN_MOCK_LEXER_H_
+
+#include <tree_sitter/parser.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+struct MockLexer {
+    // Must be the first member, the scanners only get a pointer to this.
+    TSLexer lexer;
+    const char *text;
+    size_t length;
+    // Byte offset of `lexer.lookahead`
+    size_t position;
+    // Byte length of `lexer.lookahead`
+    size_t lookahead_size;
+    // Byte offset of the last call to `mark_end`, if there was one
+    size_t token_end;
+    bool did_mark_end;
+
+    explicit MockLexer(const std::string &source) : MockLexer(source.data(), source.size()) {}
+
+    MockLexer(const char *text, size_t length) : text(text), length(length) {
+        lexer.advance = advance;
+        lexer.mark_end = mark_end;
+        lexer.get_column = get_column;
+        lexer.is_at_included_range_start = is_at_included_range_start;
+        lexer.eof = eof;
+        reset(0);
+    }
+
+    // Move to the given byte offset, as tree-sitter does before every call to `scan`
+    void reset(size_t offset) {
+        position = offset;
+        token_end = offset;
+        did_mark_end = false;
+        lexer.result_symbol = 0;
+        decode();
+    }
+
+    // The end of the token found by the last call to `scan`. Like tree-sitter this is the current
+    // position if `mark_end` was not called.
+    size_t end_of_token() const {
+        return did_mark_end ? token_end : position;
+    }
+
+    // Decode the UTF-8 sequence at `position` into `lexer.lookahead`. Invalid sequences are
+    // decoded as single bytes.
+    void decode() {
+        if (position >= length) {
+            lexer.lookahead = 0;
+            lookahead_size = 0;
+            return;
+        }
+        const uint8_t *bytes = reinterpret_cast<const uint8_t *>(text + position);
+        size_t remaining = length - position;
+        int32_t c = bytes[0];
+        size_t size = 1;
+        if (c >= 0xc0 && c < 0xe0 && remaining >= 2) {
+            c = ((c & 0x1f) << 6) | (bytes[1] & 0x3f);
+            size = 2;
+        } else if (c >= 0xe0 && c < 0xf0 && remaining >= 3) {
+            c = ((c & 0x0f) << 12) | ((bytes[1] & 0x3f) << 6) | (bytes[2] & 0x3f);
+            size = 3;
+        } else if (c >= 0xf0 && remaining >= 4) {
+            c = ((c & 0x07) << 18) | ((bytes[1] & 0x3f) << 12) | ((bytes[2] & 0x3f) << 6) | (bytes[3] & 0x3f);
+            size = 4;
+        }
+        lexer.lookahead = c;
+        lookahead_size = size;
+    }
+
+    static void advance(TSLexer *lexer, bool skip) {
+        MockLexer *self = reinterpret_cast<MockLexer *>(lexer);
+        if (self->position >= self->length) {
+            return;
+        }
+        self->position += self->lookahead_size;
+        self->decode();
+    }
+
+    static void mark_end(TSLexer *lexer) {
+        MockLexer *self = reinterpret_cast<MockLexer *>(lexer);
+        self->token_end = self->position;
+        self->did_mark_end = true;
+    }
+
+    static uint32_t get_column(TSLexer *lexer) {
+        // Like tree-sitter, this is computed by going back to the beginning of the line.
+        MockLexer *self = reinterpret_cast<MockLexer *>(lexer);
+        size_t line_start = self->position;
+        while (line_start > 0 && self->text[line_start - 1] != '\n') {
+            line_start--;
+        }
+        return self->position - line_start;
+    }
+
+    static bool is_at_included_range_start(const TSLexer *lexer) {
+        return false;
+    }
+
+    static bool eof(const TSLexer *lexer) {
+        const MockLexer *self = reinterpret_cast<const MockLexer *>(lexer);
+        return self->position >= self->length;
+    }
+};
+
+#endif // TREE_SITTER_MARKDOWN_MOCK_LEXER_H_
@@ -2,8 +2,20 @@
   "targets": [
     {
       "target_name": "tree_sitter_markdown_binding",
+      "variables": {
+        # The headers of the tree-sitter library: the one vendored by the tree-sitter package,
+        # unless TREE_SITTER_DIR points to a checkout of tree-sitter/lib. The library itself is
+        # not compiled in, the addon calls the runtime in the binary of the tree-sitter package,
+        # see bindings/node/runtime.h.
+        "tree_sitter_dir%": "<!(node -p \"process.env.TREE_SITTER_DIR || require('path').join(require('path').dirname(require.resolve('tree-sitter/package.json')), 'vendor/tree-sitter/lib')\")",
+        # Profile guided optimization, see benchmark/node/pgo.js: `generate` builds an
+        # instrumented addon that writes a profile to TREE_SITTER_MARKDOWN_PROFILE_DIR, `use`
+        # optimizes with that profile and with LTO
+        "pgo%": "<!(node -p \"process.env.TREE_SITTER_MARKDOWN_PGO || ''\")",
+        "profile_dir%": "<!(node -p \"process.env.TREE_SITTER_MARKDOWN_PROFILE_DIR || require('path').resolve('.pgo')\")",
+      },
       "include_dirs": [
-        "<!(node -e \"require('nan')\")",
+        "<(tree_sitter_dir)/include",
         "tree-sitter-markdown/src",
         "tree-sitter-markdown-inline/src",
       ],
@@ -12,10 +24,46 @@
         "tree-sitter-markdown/src/scanner.cc",
         "tree-sitter-markdown-inline/src/parser.c",
         "tree-sitter-markdown-inline/src/scanner.cc",
+        "common/markdown_parser.cc",
+        "bindings/node/batch.cc",
+        "bindings/node/flat_tree.cc",
+        "bindings/node/mapped_file.cc",
+        "bindings/node/runtime.cc",
         "bindings/node/binding.cc"
       ],
+      "defines": [
+        "NAPI_VERSION=8"
+      ],
       "cflags_c": [
         "-std=c99"
+      ],
+      "conditions": [
+        # dlopen, see bindings/node/runtime.cc
+        ["OS=='linux'", {
+          "libraries": ["-ldl"]
+        }],
+        # TREE_SITTER_MARKDOWN_STATS=1 node-gyp rebuild exports `scannerStats` and
+        # `resetScannerStats`, see common/stats.h
+        ["'<!(node -p \"process.env.TREE_SITTER_MARKDOWN_STATS || ''\")'!=''", {
+          "defines": ["TREE_SITTER_MARKDOWN_STATS"]
+        }],
+        ["pgo=='generate'", {
+          "cflags": ["-fprofile-generate=<(profile_dir)"],
+          "ldflags": ["-fprofile-generate=<(profile_dir)"],
+          "xcode_settings": {
+            "OTHER_CFLAGS": ["-fprofile-generate=<(profile_dir)"],
+            "OTHER_LDFLAGS": ["-fprofile-generate=<(profile_dir)"]
+          }
+        }],
+        ["pgo=='use'", {
+          "cflags": ["-fprofile-use=<(profile_dir)", "-flto"],
+          "ldflags": ["-fprofile-use=<(profile_dir)", "-flto"],
+          "xcode_settings": {
+            "LLVM_LTO": "YES",
+            "OTHER_CFLAGS": ["-fprofile-use=<(profile_dir)"],
+            "OTHER_LDFLAGS": ["-fprofile-use=<(profile_dir)"]
+          }
+        }]
       ]
     }
   ]
@@ -0,0 +1,117 @@
+#include "batch.h"
+#include "mapped_file.h"
+#include "../../common/markdown_parser.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <system_error>
+#include <thread>
+
+namespace TreeSitterMarkdown {
+
+namespace {
+
+// The most threads a batch uses per core
+const unsigned MAX_THREADS_PER_CORE = 2;
+
+// Counts the nodes of `tree` and records the ranges of its errors
+void Summarize(const TSTree *tree, TSTreeCursor *cursor, BatchResult *result) {
+  ts_tree_cursor_reset(cursor, ts_tree_root_node(tree));
+  bool has_error = ts_node_has_error(ts_tree_root_node(tree));
+  for (;;) {
+    TSNode node = ts_tree_cursor_current_node(cursor);
+    result->node_count++;
+    bool is_error = has_error && ts_node_symbol(node) == (TSSymbol)-1;
+    if (is_error || (has_error && ts_node_is_missing(node))) {
+      result->error_ranges.push_back(ts_node_start_byte(node));
+      result->error_ranges.push_back(ts_node_end_byte(node));
+    }
+    // The content of an error is not counted
+    if (!is_error && ts_tree_cursor_goto_first_child(cursor)) {
+      continue;
+    }
+    while (!ts_tree_cursor_goto_next_sibling(cursor)) {
+      if (!ts_tree_cursor_goto_parent(cursor)) {
+        return;
+      }
+    }
+  }
+}
+
+void ParseOne(MarkdownParser *parser, const BatchInput &input, bool flatten, BatchResult *result) {
+  MappedFile file;
+  const char *data = input.data;
+  size_t length = input.length;
+  if (!data) {
+    if (!file.Open(input.path, &result->error)) {
+      return;
+    }
+    data = file.data();
+    length = file.size();
+  }
+  if (length > UINT32_MAX) {
+    result->error = "Documents must be smaller than 4GiB";
+    return;
+  }
+  file.Advise(MappedFile::Advice::kSequential);
+  std::unique_ptr<MarkdownTree> tree(parser->parse(data, length, nullptr, [&] {
+    file.Advise(MappedFile::Advice::kRandom);
+  }));
+  if (!tree) {
+    result->error = "The parse failed or was cancelled";
+    return;
+  }
+  result->bytes = length;
+  result->inline_count = tree->inline_trees().size();
+  TSTreeCursor cursor = ts_tree_cursor_new(ts_tree_root_node(tree->block_tree()));
+  Summarize(tree->block_tree(), &cursor, result);
+  for (const TSTree *inline_tree : tree->inline_trees()) {
+    Summarize(inline_tree, &cursor, result);
+  }
+  ts_tree_cursor_delete(&cursor);
+  if (flatten) {
+    Flatten(*tree, &result->flat);
+  }
+}
+
+}  // namespace
+
+std::vector<BatchResult> ParseBatch(const std::vector<BatchInput> &inputs, unsigned thread_count, bool flatten) {
+  std::vector<BatchResult> results(inputs.size());
+  unsigned cores = std::max(std::thread::hardware_concurrency(), 1u);
+  if (thread_count == 0) {
+    thread_count = cores;
+  }
+  // More threads than cores only add memory for their parsers, so a large `threads` option is
+  // not taken literally
+  thread_count = std::min(thread_count, cores * MAX_THREADS_PER_CORE);
+  thread_count = std::min<size_t>(thread_count, inputs.size());
+
+  // Documents are handed out one at a time, so that a few large ones do not leave the other
+  // threads idle
+  std::atomic<size_t> next(0);
+  auto work = [&]() {
+    MarkdownParser parser;
+    for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < inputs.size();) {
+      ParseOne(&parser, inputs[i], flatten, &results[i]);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (unsigned i = 1; i < thread_count; i++) {
+    try {
+      threads.emplace_back(work);
+    } catch (const std::system_error &) {
+      // Out of threads. The ones that did start, and this one, still parse every document.
+      break;
+    }
+  }
+  if (thread_count > 0) {
+    work();
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  return results;
+}
+
+}  // namespace TreeSitterMarkdown
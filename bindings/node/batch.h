@@ -0,0 +1,43 @@
+// Parsing of many documents at once on a pool of threads, without any dependency on V8.
+#ifndef TREE_SITTER_MARKDOWN_BINDING_BATCH_H_
+#define TREE_SITTER_MARKDOWN_BINDING_BATCH_H_
+
+#include "flat_tree.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace TreeSitterMarkdown {
+
+// A document of a batch: either `length` bytes at `data`, which must stay valid until the batch
+// is done, or the file at `path` if `data` is null. Files are mapped into memory, see `MappedFile`.
+struct BatchInput {
+  const char *data = nullptr;
+  size_t length = 0;
+  std::string path;
+};
+
+// What is kept of a parsed document. The trees themselves are deleted right after the parse.
+struct BatchResult {
+  // Why the document could not be parsed, like a file that could not be read. All other fields
+  // are only set if this is empty.
+  std::string error;
+  size_t bytes = 0;
+  // Nodes of the block tree and all inline trees, including anonymous ones
+  uint32_t node_count = 0;
+  uint32_t inline_count = 0;
+  // Start and end byte of every `ERROR` or missing node, in document order per tree
+  std::vector<uint32_t> error_ranges;
+  // The whole tree, if the batch was asked to flatten the trees
+  FlatTree flat;
+};
+
+// Parses `inputs` on `thread_count` threads, each with a parser of its own, and returns the
+// results in the order of `inputs`. A `thread_count` of 0 uses one thread per core, and at most
+// two threads per core are used. If threads can not be created, the ones that could do the work.
+std::vector<BatchResult> ParseBatch(const std::vector<BatchInput> &inputs, unsigned thread_count, bool flatten);
+
+}  // namespace TreeSitterMarkdown
+
+#endif  // TREE_SITTER_MARKDOWN_BINDING_BATCH_H_
@@ -1,35 +1,950 @@
+#include "batch.h"
+#include "flat_tree.h"
+#include "mapped_file.h"
+#include "runtime.h"
+#include "../../common/markdown_parser.h"
 #include "tree_sitter/parser.h"
-#include <node.h>
-#include "nan.h"
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <node_api.h>
+#include "../../common/stats.h"
 
-using namespace v8;
+namespace {
 
-extern "C" TSLanguage * tree_sitter_markdown();
-extern "C" TSLanguage * tree_sitter_markdown_inline();
+// Must match the tag that the tree-sitter package checks for in `Parser.setLanguage`
+const napi_type_tag LANGUAGE_TYPE_TAG = { 0x8AF2E5212AD58ABF, 0xD5006CAD83ABBA16 };
+const napi_type_tag TREE_TYPE_TAG = { 0x6D61726B646F776E, 0x5472656500000001 };
 
-namespace {
+// Throws the error of the last failed call, unless it already left an exception pending.
+void ThrowLastError(napi_env env) {
+  bool pending;
+  if (napi_is_exception_pending(env, &pending) == napi_ok && pending) {
+    return;
+  }
+  const napi_extended_error_info *info;
+  napi_get_last_error_info(env, &info);
+  napi_throw_error(env, nullptr, info->error_message ? info->error_message : "N-API call failed");
+}
+
+// Returns `nullptr` from the calling function if `call` fails, which leaves an exception pending.
+#define NAPI_CALL(env, call)  \
+  do {                        \
+    if ((call) != napi_ok) {  \
+      ThrowLastError(env);    \
+      return nullptr;         \
+    }                         \
+  } while (0)
+
+// The state of the addon, per thread that loads it
+struct AddonData {
+  napi_ref tree_constructor = nullptr;
+};
+
+napi_value Number(napi_env env, double value) {
+  napi_value result;
+  NAPI_CALL(env, napi_create_double(env, value, &result));
+  return result;
+}
+
+napi_value PointToObject(napi_env env, TSPoint point) {
+  napi_value result;
+  NAPI_CALL(env, napi_create_object(env, &result));
+  NAPI_CALL(env, napi_set_named_property(env, result, "row", Number(env, point.row)));
+  NAPI_CALL(env, napi_set_named_property(env, result, "column", Number(env, point.column)));
+  return result;
+}
+
+bool ObjectToIndex(napi_env env, napi_value object, const char *key, uint32_t *index) {
+  napi_value value;
+  napi_valuetype type;
+  return napi_get_named_property(env, object, key, &value) == napi_ok &&
+    napi_typeof(env, value, &type) == napi_ok && type == napi_number &&
+    napi_get_value_uint32(env, value, index) == napi_ok;
+}
+
+bool ObjectToPoint(napi_env env, napi_value object, const char *key, TSPoint *point) {
+  napi_value value;
+  napi_valuetype type;
+  return napi_get_named_property(env, object, key, &value) == napi_ok &&
+    napi_typeof(env, value, &type) == napi_ok && type == napi_object &&
+    ObjectToIndex(env, value, "row", &point->row) &&
+    ObjectToIndex(env, value, "column", &point->column);
+}
+
+napi_value TreeToString(napi_env env, const TSTree *tree) {
+  char *string = ts_node_string(ts_tree_root_node(tree));
+  napi_value result;
+  napi_status status = napi_create_string_utf8(env, string, NAPI_AUTO_LENGTH, &result);
+  free(string);
+  NAPI_CALL(env, status);
+  return result;
+}
+
+// The document passed to `parse`. A string is copied to UTF-8, while the bytes of a `Buffer` or
+// any other `Uint8Array` are parsed in place as UTF-8.
+struct Text {
+  const char *data = nullptr;
+  size_t length = 0;
+  std::string copy;
+  bool in_place = false;
+  // The typed array, while a parse on the thread pool reads it
+  napi_ref array = nullptr;
+};
+
+bool GetText(napi_env env, napi_value value, Text *text) {
+  napi_valuetype type;
+  bool is_typedarray;
+  if (napi_typeof(env, value, &type) != napi_ok || napi_is_typedarray(env, value, &is_typedarray) != napi_ok) {
+    return false;
+  }
+  if (type == napi_string) {
+    size_t length;
+    if (napi_get_value_string_utf8(env, value, nullptr, 0, &length) != napi_ok) {
+      return false;
+    }
+    text->copy.resize(length + 1);
+    if (napi_get_value_string_utf8(env, value, &text->copy[0], length + 1, &length) != napi_ok) {
+      return false;
+    }
+    text->copy.resize(length);
+    text->data = text->copy.data();
+    text->length = length;
+  } else if (is_typedarray) {
+    napi_typedarray_type array_type;
+    void *data;
+    if (
+      napi_get_typedarray_info(env, value, &array_type, &text->length, &data, nullptr, nullptr) != napi_ok ||
+      array_type != napi_uint8_array
+    ) {
+      napi_throw_type_error(env, nullptr, "Expected a string, Buffer or Uint8Array");
+      return false;
+    }
+    text->data = static_cast<const char *>(data);
+    text->in_place = true;
+  } else {
+    napi_throw_type_error(env, nullptr, "Expected a string, Buffer or Uint8Array");
+    return false;
+  }
+  if (text->length > UINT32_MAX) {
+    napi_throw_range_error(env, nullptr, "Documents must be smaller than 4GiB");
+    return false;
+  }
+  return true;
+}
+
+// `{types, startIndex, endIndex, parent, firstChild, nextSibling}`, views of one `ArrayBuffer` with
+// the arrays of `tree`, see flat_tree.h. `types` is a `Uint16Array` of indices into `nodeTypes`,
+// the links between nodes are an `Int32Array` each with -1 for no node.
+napi_value FlatTreeToObject(napi_env env, const TreeSitterMarkdown::FlatTree &tree) {
+  size_t count = tree.types.size();
+  napi_value buffer, result;
+  void *data;
+  NAPI_CALL(env, napi_create_arraybuffer(env, count * (5 * sizeof(uint32_t) + sizeof(uint16_t)), &data, &buffer));
+  NAPI_CALL(env, napi_create_object(env, &result));
+  size_t offset = 0;
+  auto add = [&](const char *name, napi_typedarray_type type, const void *values, size_t size) {
+    napi_value array;
+    memcpy(static_cast<char *>(data) + offset, values, count * size);
+    if (
+      napi_create_typedarray(env, type, count, buffer, offset, &array) != napi_ok ||
+      napi_set_named_property(env, result, name, array) != napi_ok
+    ) {
+      return false;
+    }
+    offset += count * size;
+    return true;
+  };
+  if (
+    !add("startIndex", napi_uint32_array, tree.start_bytes.data(), sizeof(uint32_t)) ||
+    !add("endIndex", napi_uint32_array, tree.end_bytes.data(), sizeof(uint32_t)) ||
+    !add("parent", napi_int32_array, tree.parents.data(), sizeof(int32_t)) ||
+    !add("firstChild", napi_int32_array, tree.first_children.data(), sizeof(int32_t)) ||
+    !add("nextSibling", napi_int32_array, tree.next_siblings.data(), sizeof(int32_t)) ||
+    !add("types", napi_uint16_array, tree.types.data(), sizeof(uint16_t))
+  ) {
+    ThrowLastError(env);
+    return nullptr;
+  }
+  return result;
+}
+
+// `{names, named}`: the name of each type id of a flattened tree, and whether it is a named node
+napi_value FlatTypesToObject(napi_env env) {
+  const TreeSitterMarkdown::FlatTypes &types = TreeSitterMarkdown::GetFlatTypes();
+  napi_value result, names, named;
+  NAPI_CALL(env, napi_create_object(env, &result));
+  NAPI_CALL(env, napi_create_array_with_length(env, types.names.size(), &names));
+  NAPI_CALL(env, napi_create_array_with_length(env, types.named.size(), &named));
+  for (size_t i = 0; i < types.names.size(); i++) {
+    napi_value name, is_named;
+    NAPI_CALL(env, napi_create_string_utf8(env, types.names[i], NAPI_AUTO_LENGTH, &name));
+    NAPI_CALL(env, napi_get_boolean(env, types.named[i], &is_named));
+    NAPI_CALL(env, napi_set_element(env, names, i, name));
+    NAPI_CALL(env, napi_set_element(env, named, i, is_named));
+  }
+  NAPI_CALL(env, napi_set_named_property(env, result, "names", names));
+  NAPI_CALL(env, napi_set_named_property(env, result, "named", named));
+  return result;
+}
+
+// A combined block and inline tree returned by `MarkdownParser.parse`. Indices and columns are in
+// bytes of the UTF-8 encoding of the document.
+namespace markdown_tree {
 
-NAN_METHOD(New) {}
+// Called with an external holding the `TreeSitterMarkdown::MarkdownTree`, which can not be created from
+// JavaScript
+napi_value New(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value argv[1], self;
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, &self, nullptr));
+  napi_valuetype type = napi_undefined;
+  if (argc == 1) {
+    NAPI_CALL(env, napi_typeof(env, argv[0], &type));
+  }
+  if (type != napi_external) {
+    napi_throw_type_error(env, nullptr, "MarkdownTree can only be created by MarkdownParser.parse");
+    return nullptr;
+  }
+  void *tree;
+  NAPI_CALL(env, napi_get_value_external(env, argv[0], &tree));
+  NAPI_CALL(env, napi_wrap(env, self, tree, [](napi_env, void *tree, void *) {
+    delete static_cast<TreeSitterMarkdown::MarkdownTree *>(tree);
+  }, nullptr, nullptr));
+  NAPI_CALL(env, napi_type_tag_object(env, self, &TREE_TYPE_TAG));
+  return self;
+}
+
+napi_value NewInstance(napi_env env, TreeSitterMarkdown::MarkdownTree *tree) {
+  AddonData *data;
+  napi_value constructor, external, result;
+  if (
+    napi_get_instance_data(env, reinterpret_cast<void **>(&data)) != napi_ok ||
+    napi_get_reference_value(env, data->tree_constructor, &constructor) != napi_ok ||
+    napi_create_external(env, tree, nullptr, nullptr, &external) != napi_ok ||
+    napi_new_instance(env, constructor, 1, &external, &result) != napi_ok
+  ) {
+    delete tree;
+    ThrowLastError(env);
+    return nullptr;
+  }
+  return result;
+}
+
+// The tree wrapped by `value`, or null if it is not a `MarkdownTree`
+TreeSitterMarkdown::MarkdownTree *Unwrap(napi_env env, napi_value value) {
+  bool is_tree = false;
+  void *tree = nullptr;
+  napi_valuetype type;
+  if (
+    napi_typeof(env, value, &type) == napi_ok && type == napi_object &&
+    napi_check_object_type_tag(env, value, &TREE_TYPE_TAG, &is_tree) == napi_ok && is_tree
+  ) {
+    napi_unwrap(env, value, &tree);
+  }
+  return static_cast<TreeSitterMarkdown::MarkdownTree *>(tree);
+}
+
+TreeSitterMarkdown::MarkdownTree *This(napi_env env, napi_callback_info info, size_t *argc, napi_value *argv) {
+  napi_value self;
+  if (napi_get_cb_info(env, info, argc, argv, &self, nullptr) != napi_ok) {
+    ThrowLastError(env);
+    return nullptr;
+  }
+  TreeSitterMarkdown::MarkdownTree *tree = Unwrap(env, self);
+  if (!tree) {
+    napi_throw_type_error(env, nullptr, "Expected this to be a MarkdownTree");
+  }
+  return tree;
+}
+
+// Takes the same edit object as `Tree.edit` of the tree-sitter package
+napi_value Edit(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value argv[1];
+  TreeSitterMarkdown::MarkdownTree *tree = This(env, info, &argc, argv);
+  if (!tree) {
+    return nullptr;
+  }
+  TSInputEdit edit;
+  napi_valuetype type = napi_undefined;
+  if (argc == 1) {
+    NAPI_CALL(env, napi_typeof(env, argv[0], &type));
+  }
+  if (
+    type != napi_object ||
+    !ObjectToIndex(env, argv[0], "startIndex", &edit.start_byte) ||
+    !ObjectToIndex(env, argv[0], "oldEndIndex", &edit.old_end_byte) ||
+    !ObjectToIndex(env, argv[0], "newEndIndex", &edit.new_end_byte) ||
+    !ObjectToPoint(env, argv[0], "startPosition", &edit.start_point) ||
+    !ObjectToPoint(env, argv[0], "oldEndPosition", &edit.old_end_point) ||
+    !ObjectToPoint(env, argv[0], "newEndPosition", &edit.new_end_point)
+  ) {
+    napi_throw_type_error(env, nullptr, "Expected an edit object");
+    return nullptr;
+  }
+  tree->edit(edit);
+  return nullptr;
+}
 
-void Init(Local<Object> exports, Local<Object> module) {
-  Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(New);
-  tpl->SetClassName(Nan::New("Language").ToLocalChecked());
-  tpl->InstanceTemplate()->SetInternalFieldCount(1);
+// The block tree as an S-expression
+napi_value ToString(napi_env env, napi_callback_info info) {
+  size_t argc = 0;
+  TreeSitterMarkdown::MarkdownTree *tree = This(env, info, &argc, nullptr);
+  return tree ? TreeToString(env, tree->block_tree()) : nullptr;
+}
 
-  Local<Function> constructor = Nan::GetFunction(tpl).ToLocalChecked();
+const TSTree *InlineTreeArgument(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value argv[1];
+  TreeSitterMarkdown::MarkdownTree *tree = This(env, info, &argc, argv);
+  if (!tree) {
+    return nullptr;
+  }
+  uint32_t index;
+  napi_valuetype type = napi_undefined;
+  if (argc == 1) {
+    napi_typeof(env, argv[0], &type);
+  }
+  if (
+    type != napi_number || napi_get_value_uint32(env, argv[0], &index) != napi_ok ||
+    index >= tree->inline_trees().size()
+  ) {
+    napi_throw_range_error(env, nullptr, "Expected the index of an inline tree");
+    return nullptr;
+  }
+  return tree->inline_trees()[index];
+}
 
-  Local<Object> instance_block = constructor->NewInstance(Nan::GetCurrentContext()).ToLocalChecked();
-  Nan::SetInternalFieldPointer(instance_block, 0, tree_sitter_markdown());
-  Nan::Set(instance_block, Nan::New("name").ToLocalChecked(), Nan::New("markdown").ToLocalChecked());
-  Nan::Set(exports, Nan::New("markdown").ToLocalChecked(), instance_block);
+// The inline tree with the given index as an S-expression
+napi_value InlineToString(napi_env env, napi_callback_info info) {
+  const TSTree *tree = InlineTreeArgument(env, info);
+  return tree ? TreeToString(env, tree) : nullptr;
+}
 
-  Local<Object> instance_inline = constructor->NewInstance(Nan::GetCurrentContext()).ToLocalChecked();
-  Nan::SetInternalFieldPointer(instance_inline, 0, tree_sitter_markdown_inline());
-  Nan::Set(instance_inline, Nan::New("name").ToLocalChecked(), Nan::New("markdown_inline").ToLocalChecked());
-  Nan::Set(exports, Nan::New("markdown_inline").ToLocalChecked(), instance_inline);
+// `{startIndex, endIndex, startPosition, endPosition}` of the inline tree with the given index
+napi_value InlineRange(napi_env env, napi_callback_info info) {
+  const TSTree *tree = InlineTreeArgument(env, info);
+  if (!tree) {
+    return nullptr;
+  }
+  TSNode root = ts_tree_root_node(tree);
+  napi_value result;
+  NAPI_CALL(env, napi_create_object(env, &result));
+  NAPI_CALL(env, napi_set_named_property(env, result, "startIndex", Number(env, ts_node_start_byte(root))));
+  NAPI_CALL(env, napi_set_named_property(env, result, "endIndex", Number(env, ts_node_end_byte(root))));
+  NAPI_CALL(env, napi_set_named_property(env, result, "startPosition", PointToObject(env, ts_node_start_point(root))));
+  NAPI_CALL(env, napi_set_named_property(env, result, "endPosition", PointToObject(env, ts_node_end_point(root))));
+  return result;
 }
 
-NODE_MODULE(tree_sitter_markdown_binding, Init)
+// All nodes of the block tree and the inline trees as one tree in typed arrays, which can be walked
+// without calling back into the addon. See `FlatTreeToObject`.
+napi_value ToArrays(napi_env env, napi_callback_info info) {
+  size_t argc = 0;
+  TreeSitterMarkdown::MarkdownTree *tree = This(env, info, &argc, nullptr);
+  if (!tree) {
+    return nullptr;
+  }
+  TreeSitterMarkdown::FlatTree flat;
+  TreeSitterMarkdown::Flatten(*tree, &flat);
+  return FlatTreeToObject(env, flat);
+}
+
+napi_value InlineCount(napi_env env, napi_callback_info info) {
+  size_t argc = 0;
+  TreeSitterMarkdown::MarkdownTree *tree = This(env, info, &argc, nullptr);
+  return tree ? Number(env, tree->inline_trees().size()) : nullptr;
+}
+
+napi_value Init(napi_env env, AddonData *data) {
+  napi_property_descriptor properties[] = {
+    { "edit", nullptr, Edit, nullptr, nullptr, nullptr, napi_default, nullptr },
+    { "toString", nullptr, ToString, nullptr, nullptr, nullptr, napi_default, nullptr },
+    { "inlineToString", nullptr, InlineToString, nullptr, nullptr, nullptr, napi_default, nullptr },
+    { "inlineRange", nullptr, InlineRange, nullptr, nullptr, nullptr, napi_default, nullptr },
+    { "toArrays", nullptr, ToArrays, nullptr, nullptr, nullptr, napi_default, nullptr },
+    { "inlineCount", nullptr, nullptr, InlineCount, nullptr, nullptr, napi_default, nullptr },
+  };
+  napi_value constructor;
+  NAPI_CALL(env, napi_define_class(
+    env, "MarkdownTree", NAPI_AUTO_LENGTH, New, nullptr,
+    sizeof(properties) / sizeof(properties[0]), properties, &constructor
+  ));
+  NAPI_CALL(env, napi_create_reference(env, constructor, 1, &data->tree_constructor));
+  return constructor;
+}
+
+}  // namespace markdown_tree
+
+// Parses a document with the block grammar and all of its inline content with the inline grammar
+// in one call, without going through JavaScript for each `inline` node.
+namespace markdown_parser {
+
+napi_value New(napi_env env, napi_callback_info info) {
+  napi_value self, target;
+  NAPI_CALL(env, napi_get_cb_info(env, info, nullptr, nullptr, &self, nullptr));
+  NAPI_CALL(env, napi_get_new_target(env, info, &target));
+  if (!target) {
+    napi_throw_type_error(env, nullptr, "MarkdownParser must be called with new");
+    return nullptr;
+  }
+  TreeSitterMarkdown::MarkdownParser *parser = new TreeSitterMarkdown::MarkdownParser();
+  napi_status status = napi_wrap(env, self, parser, [](napi_env, void *parser, void *) {
+    delete static_cast<TreeSitterMarkdown::MarkdownParser *>(parser);
+  }, nullptr, nullptr);
+  if (status != napi_ok) {
+    delete parser;
+    ThrowLastError(env);
+    return nullptr;
+  }
+  return self;
+}
+
+// Reads the arguments `(text, oldTree)` of `parse` and `parseAsync`
+bool GetArguments(
+  napi_env env, napi_callback_info info, TreeSitterMarkdown::MarkdownParser **parser,
+  Text *text, napi_value *text_value, const TreeSitterMarkdown::MarkdownTree **old_tree
+) {
+  size_t argc = 2;
+  napi_value argv[2], self;
+  if (
+    napi_get_cb_info(env, info, &argc, argv, &self, nullptr) != napi_ok ||
+    napi_unwrap(env, self, reinterpret_cast<void **>(parser)) != napi_ok
+  ) {
+    ThrowLastError(env);
+    return false;
+  }
+  if (argc < 1) {
+    napi_throw_type_error(env, nullptr, "Expected a string, Buffer or Uint8Array");
+    return false;
+  }
+  if (!GetText(env, argv[0], text)) {
+    ThrowLastError(env);
+    return false;
+  }
+  *text_value = argv[0];
+  *old_tree = nullptr;
+  napi_valuetype type = napi_undefined;
+  if (argc > 1) {
+    napi_typeof(env, argv[1], &type);
+  }
+  if (type != napi_undefined && type != napi_null) {
+    *old_tree = markdown_tree::Unwrap(env, argv[1]);
+    if (!*old_tree) {
+      napi_throw_type_error(env, nullptr, "Expected the old tree to be a MarkdownTree");
+      return false;
+    }
+  }
+  return true;
+}
+
+// `parse(text, oldTree)`, where `text` is a string, `Buffer` or `Uint8Array` and `oldTree` is an
+// optional `MarkdownTree` that was edited to match `text`.
+napi_value Parse(napi_env env, napi_callback_info info) {
+  TreeSitterMarkdown::MarkdownParser *parser;
+  Text text;
+  napi_value text_value;
+  const TreeSitterMarkdown::MarkdownTree *old_tree;
+  if (!GetArguments(env, info, &parser, &text, &text_value, &old_tree)) {
+    return nullptr;
+  }
+  TreeSitterMarkdown::MarkdownTree *tree = parser->parse(text.data, text.length, old_tree);
+  if (!tree) {
+    napi_value null;
+    NAPI_CALL(env, napi_get_null(env, &null));
+    return null;
+  }
+  return markdown_tree::NewInstance(env, tree);
+}
+
+// `parseFile(path, oldTree)` is `parse` of the file at `path`, which is mapped into memory rather
+// than read into a `Buffer` first. Throws if the file can not be mapped. A file that another
+// process truncates during the parse crashes the process with SIGBUS; see `MappedFile`.
+napi_value ParseFile(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value argv[2], self;
+  TreeSitterMarkdown::MarkdownParser *parser;
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, &self, nullptr));
+  NAPI_CALL(env, napi_unwrap(env, self, reinterpret_cast<void **>(&parser)));
+  napi_valuetype type = napi_undefined;
+  if (argc > 0) {
+    NAPI_CALL(env, napi_typeof(env, argv[0], &type));
+  }
+  if (type != napi_string) {
+    napi_throw_type_error(env, nullptr, "Expected a path");
+    return nullptr;
+  }
+  size_t path_length;
+  NAPI_CALL(env, napi_get_value_string_utf8(env, argv[0], nullptr, 0, &path_length));
+  std::string path(path_length, '\0');
+  NAPI_CALL(env, napi_get_value_string_utf8(env, argv[0], &path[0], path_length + 1, &path_length));
+  const TreeSitterMarkdown::MarkdownTree *old_tree = nullptr;
+  type = napi_undefined;
+  if (argc > 1) {
+    NAPI_CALL(env, napi_typeof(env, argv[1], &type));
+  }
+  if (type != napi_undefined && type != napi_null) {
+    old_tree = markdown_tree::Unwrap(env, argv[1]);
+    if (!old_tree) {
+      napi_throw_type_error(env, nullptr, "Expected the old tree to be a MarkdownTree");
+      return nullptr;
+    }
+  }
+
+  TreeSitterMarkdown::MappedFile file;
+  std::string error;
+  if (!file.Open(path, &error)) {
+    napi_throw_error(env, nullptr, error.c_str());
+    return nullptr;
+  }
+  if (file.size() > UINT32_MAX) {
+    napi_throw_range_error(env, nullptr, "Documents must be smaller than 4GiB");
+    return nullptr;
+  }
+  file.Advise(TreeSitterMarkdown::MappedFile::Advice::kSequential);
+  TreeSitterMarkdown::MarkdownTree *tree = parser->parse(file.data(), file.size(), old_tree, [&] {
+    file.Advise(TreeSitterMarkdown::MappedFile::Advice::kRandom);
+  });
+  if (!tree) {
+    napi_value null;
+    NAPI_CALL(env, napi_get_null(env, &null));
+    return null;
+  }
+  return markdown_tree::NewInstance(env, tree);
+}
+
+// A parse on the libuv thread pool. Each parse gets a parser of its own, so parses started
+// together run in parallel.
+struct ParseWork {
+  napi_async_work work = nullptr;
+  napi_deferred deferred = nullptr;
+  Text text;
+  std::unique_ptr<TreeSitterMarkdown::MarkdownTree> old_tree;
+  TreeSitterMarkdown::MarkdownTree *tree = nullptr;
+};
+
+void ExecuteParse(napi_env, void *data) {
+  ParseWork *work = static_cast<ParseWork *>(data);
+  TreeSitterMarkdown::MarkdownParser parser;
+  work->tree = parser.parse(work->text.data, work->text.length, work->old_tree.get());
+}
+
+void CompleteParse(napi_env env, napi_status status, void *data) {
+  std::unique_ptr<ParseWork> work(static_cast<ParseWork *>(data));
+  if (work->text.array) {
+    napi_delete_reference(env, work->text.array);
+  }
+  napi_delete_async_work(env, work->work);
+  napi_value result;
+  if (status != napi_ok) {
+    delete work->tree;
+    napi_create_string_utf8(env, "The parse was cancelled", NAPI_AUTO_LENGTH, &result);
+    napi_create_error(env, nullptr, result, &result);
+    napi_reject_deferred(env, work->deferred, result);
+    return;
+  }
+  if (work->tree) {
+    result = markdown_tree::NewInstance(env, work->tree);
+  } else {
+    napi_get_null(env, &result);
+  }
+  if (result) {
+    napi_resolve_deferred(env, work->deferred, result);
+  } else {
+    napi_value error;
+    napi_get_and_clear_last_exception(env, &error);
+    napi_reject_deferred(env, work->deferred, error);
+  }
+}
+
+// `parseAsync(text, oldTree)` is `parse` on the libuv thread pool and returns a promise of the
+// tree. `oldTree` is copied before the promise is returned and can be used again right away. A
+// `Buffer` or `Uint8Array` is read in place, so it must not be changed until the promise settles.
+napi_value ParseAsync(napi_env env, napi_callback_info info) {
+  TreeSitterMarkdown::MarkdownParser *parser;
+  std::unique_ptr<ParseWork> work(new ParseWork());
+  napi_value text_value;
+  const TreeSitterMarkdown::MarkdownTree *old_tree;
+  if (!GetArguments(env, info, &parser, &work->text, &text_value, &old_tree)) {
+    return nullptr;
+  }
+  if (work->text.in_place) {
+    NAPI_CALL(env, napi_create_reference(env, text_value, 1, &work->text.array));
+  }
+  if (old_tree) {
+    work->old_tree.reset(old_tree->copy());
+  }
+  napi_value promise, name;
+  NAPI_CALL(env, napi_create_promise(env, &work->deferred, &promise));
+  NAPI_CALL(env, napi_create_string_utf8(env, "tree-sitter-markdown:parse", NAPI_AUTO_LENGTH, &name));
+  NAPI_CALL(env, napi_create_async_work(env, nullptr, name, ExecuteParse, CompleteParse, work.get(), &work->work));
+  NAPI_CALL(env, napi_queue_async_work(env, work->work));
+  work.release();
+  return promise;
+}
+
+napi_value Init(napi_env env) {
+  napi_property_descriptor properties[] = {
+    { "parse", nullptr, Parse, nullptr, nullptr, nullptr, napi_default, nullptr },
+    { "parseAsync", nullptr, ParseAsync, nullptr, nullptr, nullptr, napi_default, nullptr },
+    { "parseFile", nullptr, ParseFile, nullptr, nullptr, nullptr, napi_default, nullptr },
+  };
+  napi_value constructor;
+  NAPI_CALL(env, napi_define_class(
+    env, "MarkdownParser", NAPI_AUTO_LENGTH, New, nullptr,
+    sizeof(properties) / sizeof(properties[0]), properties, &constructor
+  ));
+  return constructor;
+}
+
+}  // namespace markdown_parser
+
+// `parseBatch(inputs, options)` parses many documents at once on a pool of threads of its own and
+// returns a promise of one result per input. An input is a `Buffer` or `Uint8Array`, which is read
+// in place and must not be changed until the promise settles, or the path of a file. The option
+// `threads` defaults to the number of cores and is capped at twice that.
+//
+// A result is `{bytes, nodeCount, inlineCount}`, with `errors`, a `Uint32Array` of the start and
+// end byte of every error, if the document has any, or `{error}` if it could not be parsed. With
+// the option `flat`, it also has the whole tree as `tree`, in the form of `MarkdownTree.toArrays`.
+// No tree wrappers are created, so nothing needs to be collected besides the results.
+namespace batch {
+
+struct BatchWork {
+  napi_async_work work = nullptr;
+  napi_deferred deferred = nullptr;
+  std::vector<TreeSitterMarkdown::BatchInput> inputs;
+  // The arrays of the inputs that are read in place
+  std::vector<napi_ref> arrays;
+  unsigned thread_count = 0;
+  bool flatten = false;
+  std::vector<TreeSitterMarkdown::BatchResult> results;
+};
+
+void Execute(napi_env, void *data) {
+  BatchWork *work = static_cast<BatchWork *>(data);
+  work->results = TreeSitterMarkdown::ParseBatch(work->inputs, work->thread_count, work->flatten);
+}
+
+napi_value ResultToObject(napi_env env, const TreeSitterMarkdown::BatchResult &result, bool flatten) {
+  napi_value object;
+  NAPI_CALL(env, napi_create_object(env, &object));
+  if (!result.error.empty()) {
+    napi_value error;
+    NAPI_CALL(env, napi_create_string_utf8(env, result.error.data(), result.error.size(), &error));
+    NAPI_CALL(env, napi_set_named_property(env, object, "error", error));
+    return object;
+  }
+  NAPI_CALL(env, napi_set_named_property(env, object, "bytes", Number(env, result.bytes)));
+  NAPI_CALL(env, napi_set_named_property(env, object, "nodeCount", Number(env, result.node_count)));
+  NAPI_CALL(env, napi_set_named_property(env, object, "inlineCount", Number(env, result.inline_count)));
+  if (!result.error_ranges.empty()) {
+    napi_value buffer, errors;
+    void *data;
+    size_t size = result.error_ranges.size() * sizeof(uint32_t);
+    NAPI_CALL(env, napi_create_arraybuffer(env, size, &data, &buffer));
+    memcpy(data, result.error_ranges.data(), size);
+    NAPI_CALL(env, napi_create_typedarray(env, napi_uint32_array, result.error_ranges.size(), buffer, 0, &errors));
+    NAPI_CALL(env, napi_set_named_property(env, object, "errors", errors));
+  }
+  if (flatten) {
+    napi_value tree = FlatTreeToObject(env, result.flat);
+    if (!tree) {
+      return nullptr;
+    }
+    NAPI_CALL(env, napi_set_named_property(env, object, "tree", tree));
+  }
+  return object;
+}
+
+napi_value ResultsToArray(napi_env env, const std::vector<TreeSitterMarkdown::BatchResult> &results, bool flatten) {
+  napi_value array;
+  NAPI_CALL(env, napi_create_array_with_length(env, results.size(), &array));
+  for (size_t i = 0; i < results.size(); i++) {
+    napi_value object = ResultToObject(env, results[i], flatten);
+    if (!object) {
+      return nullptr;
+    }
+    NAPI_CALL(env, napi_set_element(env, array, i, object));
+  }
+  return array;
+}
+
+void Complete(napi_env env, napi_status status, void *data) {
+  std::unique_ptr<BatchWork> work(static_cast<BatchWork *>(data));
+  for (napi_ref array : work->arrays) {
+    napi_delete_reference(env, array);
+  }
+  napi_delete_async_work(env, work->work);
+  napi_value result = nullptr;
+  if (status == napi_ok) {
+    result = ResultsToArray(env, work->results, work->flatten);
+  } else {
+    napi_throw_error(env, nullptr, "The batch was cancelled");
+  }
+  if (result) {
+    napi_resolve_deferred(env, work->deferred, result);
+  } else {
+    napi_value error;
+    napi_get_and_clear_last_exception(env, &error);
+    napi_reject_deferred(env, work->deferred, error);
+  }
+}
+
+// Reads the inputs into `work`, returning false with an exception pending if one is invalid
+bool GetInputs(napi_env env, napi_value array, BatchWork *work) {
+  uint32_t length;
+  if (napi_get_array_length(env, array, &length) != napi_ok) {
+    napi_throw_type_error(env, nullptr, "Expected an array of inputs");
+    return false;
+  }
+  work->inputs.resize(length);
+  for (uint32_t i = 0; i < length; i++) {
+    napi_value value;
+    napi_valuetype type;
+    bool is_typedarray;
+    if (
+      napi_get_element(env, array, i, &value) != napi_ok ||
+      napi_typeof(env, value, &type) != napi_ok ||
+      napi_is_typedarray(env, value, &is_typedarray) != napi_ok
+    ) {
+      ThrowLastError(env);
+      return false;
+    }
+    TreeSitterMarkdown::BatchInput &input = work->inputs[i];
+    if (type == napi_string) {
+      size_t path_length;
+      if (napi_get_value_string_utf8(env, value, nullptr, 0, &path_length) != napi_ok) {
+        ThrowLastError(env);
+        return false;
+      }
+      input.path.resize(path_length + 1);
+      napi_get_value_string_utf8(env, value, &input.path[0], path_length + 1, &path_length);
+      input.path.resize(path_length);
+      continue;
+    }
+    if (!is_typedarray) {
+      napi_throw_type_error(env, nullptr, "Expected each input to be a path, Buffer or Uint8Array");
+      return false;
+    }
+    Text text;
+    if (!GetText(env, value, &text)) {
+      ThrowLastError(env);
+      return false;
+    }
+    napi_ref reference;
+    if (napi_create_reference(env, value, 1, &reference) != napi_ok) {
+      ThrowLastError(env);
+      return false;
+    }
+    work->arrays.push_back(reference);
+    input.data = text.data;
+    input.length = text.length;
+  }
+  return true;
+}
+
+napi_value ParseBatch(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value argv[2];
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, nullptr, nullptr));
+  bool is_array = false;
+  if (argc > 0) {
+    NAPI_CALL(env, napi_is_array(env, argv[0], &is_array));
+  }
+  if (!is_array) {
+    napi_throw_type_error(env, nullptr, "Expected an array of inputs");
+    return nullptr;
+  }
+  std::unique_ptr<BatchWork> work(new BatchWork());
+  napi_valuetype type = napi_undefined;
+  if (argc > 1) {
+    NAPI_CALL(env, napi_typeof(env, argv[1], &type));
+  }
+  if (type == napi_object) {
+    napi_value threads, flat;
+    bool has_threads, has_flat;
+    NAPI_CALL(env, napi_has_named_property(env, argv[1], "flat", &has_flat));
+    if (has_flat) {
+      NAPI_CALL(env, napi_get_named_property(env, argv[1], "flat", &flat));
+      NAPI_CALL(env, napi_coerce_to_bool(env, flat, &flat));
+      NAPI_CALL(env, napi_get_value_bool(env, flat, &work->flatten));
+    }
+    NAPI_CALL(env, napi_has_named_property(env, argv[1], "threads", &has_threads));
+    if (has_threads) {
+      NAPI_CALL(env, napi_get_named_property(env, argv[1], "threads", &threads));
+      if (napi_get_value_uint32(env, threads, &work->thread_count) != napi_ok) {
+        napi_throw_type_error(env, nullptr, "Expected threads to be a number");
+        return nullptr;
+      }
+    }
+  } else if (type != napi_undefined) {
+    napi_throw_type_error(env, nullptr, "Expected an options object");
+    return nullptr;
+  }
+  if (!GetInputs(env, argv[0], work.get())) {
+    for (napi_ref array : work->arrays) {
+      napi_delete_reference(env, array);
+    }
+    return nullptr;
+  }
+  napi_value promise, name;
+  NAPI_CALL(env, napi_create_promise(env, &work->deferred, &promise));
+  NAPI_CALL(env, napi_create_string_utf8(env, "tree-sitter-markdown:parseBatch", NAPI_AUTO_LENGTH, &name));
+  NAPI_CALL(env, napi_create_async_work(env, nullptr, name, Execute, Complete, work.get(), &work->work));
+  NAPI_CALL(env, napi_queue_async_work(env, work->work));
+  work.release();
+  return promise;
+}
+
+}  // namespace batch
+
+// `{name, language}`, where `language` is the external that `Parser.setLanguage` of the
+// tree-sitter package expects
+napi_value LanguageObject(napi_env env, const char *name, const TSLanguage *language) {
+  napi_value result, name_value, external;
+  NAPI_CALL(env, napi_create_object(env, &result));
+  NAPI_CALL(env, napi_create_string_utf8(env, name, NAPI_AUTO_LENGTH, &name_value));
+  NAPI_CALL(env, napi_set_named_property(env, result, "name", name_value));
+  NAPI_CALL(env, napi_create_external(env, const_cast<TSLanguage *>(language), nullptr, nullptr, &external));
+  NAPI_CALL(env, napi_type_tag_object(env, external, &LANGUAGE_TYPE_TAG));
+  NAPI_CALL(env, napi_set_named_property(env, result, "language", external));
+  return result;
+}
+
+#ifdef TREE_SITTER_MARKDOWN_STATS
+napi_value StatsToArray(napi_env env, const TSMarkdownScannerStats *stats, uint32_t count) {
+  napi_value result;
+  NAPI_CALL(env, napi_create_array_with_length(env, count, &result));
+  for (uint32_t i = 0; i < count; i++) {
+    napi_value token, name, lookahead;
+    NAPI_CALL(env, napi_create_object(env, &token));
+    NAPI_CALL(env, napi_create_string_utf8(env, stats[i].name, NAPI_AUTO_LENGTH, &name));
+    NAPI_CALL(env, napi_set_named_property(env, token, "name", name));
+    NAPI_CALL(env, napi_set_named_property(env, token, "valid", Number(env, stats[i].valid)));
+    NAPI_CALL(env, napi_set_named_property(env, token, "emitted", Number(env, stats[i].emitted)));
+    NAPI_CALL(env, napi_set_named_property(env, token, "simulated", Number(env, stats[i].simulated)));
+    NAPI_CALL(env, napi_set_named_property(env, token, "advanced", Number(env, stats[i].advanced)));
+    NAPI_CALL(env, napi_set_named_property(env, token, "cycles", Number(env, stats[i].cycles)));
+    NAPI_CALL(env, napi_set_named_property(env, token, "maxLookahead", Number(env, stats[i].max_lookahead)));
+    NAPI_CALL(env, napi_create_array_with_length(env, TS_MARKDOWN_LOOKAHEAD_BUCKETS, &lookahead));
+    for (uint32_t bucket = 0; bucket < TS_MARKDOWN_LOOKAHEAD_BUCKETS; bucket++) {
+      NAPI_CALL(env, napi_set_element(env, lookahead, bucket, Number(env, stats[i].lookahead[bucket])));
+    }
+    NAPI_CALL(env, napi_set_named_property(env, token, "lookahead", lookahead));
+    NAPI_CALL(env, napi_set_element(env, result, i, token));
+  }
+  return result;
+}
+
+// Returns `{block, inline}`, each an array with the counters of every external token, see
+// common/stats.h. The counters are kept per thread, so this only counts the parses that ran on the
+// main thread. `parseAsync` and `parseBatch` parse on worker threads and are not counted.
+napi_value ScannerStats(napi_env env, napi_callback_info) {
+  uint32_t count;
+  napi_value result;
+  NAPI_CALL(env, napi_create_object(env, &result));
+  const TSMarkdownScannerStats *block = tree_sitter_markdown_scanner_stats(&count);
+  NAPI_CALL(env, napi_set_named_property(env, result, "block", StatsToArray(env, block, count)));
+  const TSMarkdownScannerStats *inline_ = tree_sitter_markdown_inline_scanner_stats(&count);
+  NAPI_CALL(env, napi_set_named_property(env, result, "inline", StatsToArray(env, inline_, count)));
+  return result;
+}
+
+napi_value ResetScannerStats(napi_env, napi_callback_info) {
+  tree_sitter_markdown_scanner_stats_reset();
+  tree_sitter_markdown_inline_scanner_stats_reset();
+  return nullptr;
+}
+#endif
+
+// `loadRuntime(path)` loads the tree-sitter runtime from the binary of the tree-sitter package at
+// `path` and returns the exports that parse with it. Throws if the binary does not export the
+// runtime, or if its runtime can not run the languages of this package.
+napi_value LoadRuntime(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value argv[1];
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, nullptr, nullptr));
+  napi_valuetype type = napi_undefined;
+  if (argc > 0) {
+    NAPI_CALL(env, napi_typeof(env, argv[0], &type));
+  }
+  if (type != napi_string) {
+    napi_throw_type_error(env, nullptr, "Expected a path");
+    return nullptr;
+  }
+  size_t path_length;
+  NAPI_CALL(env, napi_get_value_string_utf8(env, argv[0], nullptr, 0, &path_length));
+  std::string path(path_length, '\0');
+  NAPI_CALL(env, napi_get_value_string_utf8(env, argv[0], &path[0], path_length + 1, &path_length));
+  std::string error;
+  if (!TreeSitterMarkdown::LoadRuntime(path, &error)) {
+    napi_throw_error(env, nullptr, error.c_str());
+    return nullptr;
+  }
+
+  // The runtime rejects languages of an ABI version it does not support
+  TSParser *parser = ts_parser_new();
+  const TSLanguage *languages[] = { tree_sitter_markdown(), tree_sitter_markdown_inline() };
+  for (const TSLanguage *language : languages) {
+    if (!ts_parser_set_language(parser, language)) {
+      ts_parser_delete(parser);
+      error = "The tree-sitter runtime in " + path + " can not run languages of ABI version " +
+        std::to_string(language->version) + ", update the tree-sitter package";
+      napi_throw_error(env, nullptr, error.c_str());
+      return nullptr;
+    }
+  }
+  ts_parser_delete(parser);
+
+  AddonData *data;
+  NAPI_CALL(env, napi_get_instance_data(env, reinterpret_cast<void **>(&data)));
+  napi_value result;
+  NAPI_CALL(env, napi_create_object(env, &result));
+  napi_property_descriptor properties[] = {
+    { "MarkdownParser", nullptr, nullptr, nullptr, nullptr, markdown_parser::Init(env), napi_enumerable, nullptr },
+    { "MarkdownTree", nullptr, nullptr, nullptr, nullptr, markdown_tree::Init(env, data), napi_enumerable, nullptr },
+    { "parseBatch", nullptr, batch::ParseBatch, nullptr, nullptr, nullptr, napi_enumerable, nullptr },
+    { "nodeTypes", nullptr, nullptr, nullptr, nullptr, FlatTypesToObject(env), napi_enumerable, nullptr },
+#ifdef TREE_SITTER_MARKDOWN_STATS
+    { "scannerStats", nullptr, ScannerStats, nullptr, nullptr, nullptr, napi_enumerable, nullptr },
+    { "resetScannerStats", nullptr, ResetScannerStats, nullptr, nullptr, nullptr, napi_enumerable, nullptr },
+#endif
+  };
+  NAPI_CALL(env, napi_define_properties(env, result, sizeof(properties) / sizeof(properties[0]), properties));
+  return result;
+}
+
+// The languages do not need a runtime, so they are exported right away. Everything else is
+// returned by `loadRuntime`, which bindings/node/index.js calls when it is first used.
+napi_value Init(napi_env env, napi_value exports) {
+  AddonData *data = new AddonData();
+  napi_status status = napi_set_instance_data(env, data, [](napi_env env, void *data, void *) {
+    AddonData *addon_data = static_cast<AddonData *>(data);
+    if (addon_data->tree_constructor) {
+      napi_delete_reference(env, addon_data->tree_constructor);
+    }
+    delete addon_data;
+  }, nullptr);
+  if (status != napi_ok) {
+    delete data;
+    ThrowLastError(env);
+    return nullptr;
+  }
+
+  napi_property_descriptor properties[] = {
+    { "markdown", nullptr, nullptr, nullptr, nullptr, LanguageObject(env, "markdown", tree_sitter_markdown()), napi_enumerable, nullptr },
+    { "markdown_inline", nullptr, nullptr, nullptr, nullptr, LanguageObject(env, "markdown_inline", tree_sitter_markdown_inline()), napi_enumerable, nullptr },
+    { "loadRuntime", nullptr, LoadRuntime, nullptr, nullptr, nullptr, napi_default, nullptr },
+  };
+  NAPI_CALL(env, napi_define_properties(env, exports, sizeof(properties) / sizeof(properties[0]), properties));
+  return exports;
+}
 
 }  // namespace
 
+NAPI_MODULE(NODE_GYP_MODULE_NAME, Init)
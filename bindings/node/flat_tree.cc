@@ -0,0 +1,143 @@
+#include "flat_tree.h"
+
+namespace TreeSitterMarkdown {
+
+namespace {
+
+class Flattener {
+ public:
+  Flattener(FlatTree *result)
+      : result_(result),
+        inline_offset_(ts_language_symbol_count(tree_sitter_markdown())),
+        error_type_(inline_offset_ + ts_language_symbol_count(tree_sitter_markdown_inline())) {}
+
+  ~Flattener() {
+    if (has_cursors_) {
+      ts_tree_cursor_delete(&block_cursor_);
+      ts_tree_cursor_delete(&cursor_);
+    }
+  }
+
+  void Run(const MarkdownTree &tree) {
+    TSNode root = ts_tree_root_node(tree.block_tree());
+    block_cursor_ = ts_tree_cursor_new(root);
+    cursor_ = ts_tree_cursor_new(root);
+    has_cursors_ = true;
+    Walk(&block_cursor_, root, 0, -1, &tree);
+  }
+
+ private:
+  int32_t Add(TSNode node, uint16_t offset, int32_t parent) {
+    int32_t index = result_->types.size();
+    TSSymbol symbol = ts_node_symbol(node);
+    result_->types.push_back(symbol == (TSSymbol)-1 ? error_type_ : symbol + offset);
+    result_->start_bytes.push_back(ts_node_start_byte(node));
+    result_->end_bytes.push_back(ts_node_end_byte(node));
+    result_->parents.push_back(parent);
+    result_->first_children.push_back(-1);
+    result_->next_siblings.push_back(-1);
+    last_children_.push_back(-1);
+    if (parent >= 0) {
+      if (last_children_[parent] >= 0) {
+        result_->next_siblings[last_children_[parent]] = index;
+      } else {
+        result_->first_children[parent] = index;
+      }
+      last_children_[parent] = index;
+    }
+    return index;
+  }
+
+  // Adds `root` and all of its descendants below `parent`. If `tree` is given, the inline trees of
+  // its `inline` nodes are added as well.
+  void Walk(TSTreeCursor *cursor, TSNode root, uint16_t offset, int32_t parent, const MarkdownTree *tree) {
+    ts_tree_cursor_reset(cursor, root);
+    std::vector<int32_t> ancestors = { parent };
+    for (;;) {
+      TSNode node = ts_tree_cursor_current_node(cursor);
+      int32_t index = Add(node, offset, ancestors.back());
+      const TSTree *inline_tree = tree ? tree->inline_tree(node) : nullptr;
+      if (inline_tree) {
+        AddInline(node, inline_tree, index);
+      } else if (ts_tree_cursor_goto_first_child(cursor)) {
+        ancestors.push_back(index);
+        continue;
+      }
+      while (!ts_tree_cursor_goto_next_sibling(cursor)) {
+        if (ancestors.size() == 1 || !ts_tree_cursor_goto_parent(cursor)) {
+          return;
+        }
+        ancestors.pop_back();
+      }
+    }
+  }
+
+  void Children(TSNode node, std::vector<TSNode> *children) {
+    children->clear();
+    ts_tree_cursor_reset(&cursor_, node);
+    if (ts_tree_cursor_goto_first_child(&cursor_)) {
+      do {
+        children->push_back(ts_tree_cursor_current_node(&cursor_));
+      } while (ts_tree_cursor_goto_next_sibling(&cursor_));
+    }
+  }
+
+  // Adds the children of the `inline` node at `index` of the block tree, merged with the children
+  // of the root of its inline tree. Neither contains `inline` nodes, so this does not recurse.
+  void AddInline(TSNode node, const TSTree *inline_tree, int32_t index) {
+    Children(node, &block_children_);
+    Children(ts_tree_root_node(inline_tree), &inline_children_);
+    size_t i = 0, j = 0;
+    while (i < block_children_.size() || j < inline_children_.size()) {
+      bool block = j == inline_children_.size() || (
+        i < block_children_.size() &&
+        ts_node_start_byte(block_children_[i]) <= ts_node_start_byte(inline_children_[j])
+      );
+      if (block) {
+        Walk(&cursor_, block_children_[i++], 0, index, nullptr);
+      } else {
+        Walk(&cursor_, inline_children_[j++], inline_offset_, index, nullptr);
+      }
+    }
+  }
+
+  FlatTree *result_;
+  const uint16_t inline_offset_;
+  const uint16_t error_type_;
+  // The cursor of the block tree, and one for everything below `inline` nodes
+  TSTreeCursor block_cursor_;
+  TSTreeCursor cursor_;
+  bool has_cursors_ = false;
+  std::vector<int32_t> last_children_;
+  std::vector<TSNode> block_children_;
+  std::vector<TSNode> inline_children_;
+};
+
+void AddTypes(const TSLanguage *language, FlatTypes *types) {
+  uint32_t count = ts_language_symbol_count(language);
+  for (TSSymbol symbol = 0; symbol < count; symbol++) {
+    types->names.push_back(ts_language_symbol_name(language, symbol));
+    types->named.push_back(ts_language_symbol_type(language, symbol) == TSSymbolTypeRegular);
+  }
+}
+
+}  // namespace
+
+void Flatten(const MarkdownTree &tree, FlatTree *result) {
+  *result = FlatTree();
+  Flattener(result).Run(tree);
+}
+
+const FlatTypes &GetFlatTypes() {
+  static const FlatTypes types = [] {
+    FlatTypes types;
+    AddTypes(tree_sitter_markdown(), &types);
+    AddTypes(tree_sitter_markdown_inline(), &types);
+    types.names.push_back("ERROR");
+    types.named.push_back(true);
+    return types;
+  }();
+  return types;
+}
+
+}  // namespace TreeSitterMarkdown
@@ -0,0 +1,40 @@
+// A `MarkdownTree` flattened into arrays, so that it can be walked without calls into tree-sitter.
+#ifndef TREE_SITTER_MARKDOWN_BINDING_FLAT_TREE_H_
+#define TREE_SITTER_MARKDOWN_BINDING_FLAT_TREE_H_
+
+#include "../../common/markdown_parser.h"
+#include <cstdint>
+#include <vector>
+
+namespace TreeSitterMarkdown {
+
+// The nodes of the block tree and of all inline trees in one tree, in pre-order. The children of
+// an `inline` node of the block tree are its own children merged with the children of the root of
+// its inline tree, ordered by their start byte.
+//
+// Node `i` has the type `types[i]`, see `FlatTypes`, and spans the bytes from `start_bytes[i]` to
+// `end_bytes[i]`. The links to other nodes are indices, or -1 if there is no such node. Node 0 is
+// the root.
+struct FlatTree {
+  std::vector<uint16_t> types;
+  std::vector<uint32_t> start_bytes;
+  std::vector<uint32_t> end_bytes;
+  std::vector<int32_t> parents;
+  std::vector<int32_t> first_children;
+  std::vector<int32_t> next_siblings;
+};
+
+// The node types of a `FlatTree`: the symbols of the block grammar, followed by the symbols of the
+// inline grammar, followed by `ERROR`.
+struct FlatTypes {
+  std::vector<const char *> names;
+  std::vector<bool> named;
+};
+
+void Flatten(const MarkdownTree &tree, FlatTree *result);
+
+const FlatTypes &GetFlatTypes();
+
+}  // namespace TreeSitterMarkdown
+
+#endif  // TREE_SITTER_MARKDOWN_BINDING_FLAT_TREE_H_
@@ -14,6 +14,33 @@ try {
   }
 }
 
+// Everything but the languages parses with the tree-sitter runtime in the binary of the
+// tree-sitter package, which is loaded the first time one of these exports is used. So the
+// languages can be used without that runtime.
+const path = require("path");
+const binding = module.exports;
+let runtime;
+
+function loadRuntime() {
+  if (!runtime) {
+    require("tree-sitter");
+    const dir = path.dirname(require.resolve("tree-sitter/package.json"));
+    const file = Object.keys(require.cache).find(
+      (file) => file.startsWith(dir + path.sep) && file.endsWith(".node")
+    );
+    if (!file) {
+      throw new Error(`The binary of the tree-sitter package in ${dir} is not loaded`);
+    }
+    runtime = binding.loadRuntime(file);
+  }
+  return runtime;
+}
+
+module.exports = { markdown: binding.markdown, markdown_inline: binding.markdown_inline };
+for (const name of ["MarkdownParser", "MarkdownTree", "parseBatch", "nodeTypes", "scannerStats", "resetScannerStats"]) {
+  Object.defineProperty(module.exports, name, { enumerable: true, get: () => loadRuntime()[name] });
+}
+
 try {
   module.exports.nodeTypeInfo = require("../../tree-sitter-markdown/src/node-types.json");
   module.exports.nodeTypeInfoInline = require("../../tree-sitter-markdown-inline/src/node-types.json");
@@ -0,0 +1,114 @@
+#include "mapped_file.h"
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace TreeSitterMarkdown {
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+  if (mapped_) {
+    munmap(const_cast<char *>(data_), size_);
+  }
+#endif
+}
+
+#ifndef _WIN32
+
+// Reads a file that can not be mapped. Stops once the file is larger than any document can be, so
+// that a device without an end does not fill the memory.
+static bool ReadAll(int fd, std::string *contents) {
+  char buffer[1 << 16];
+  while (contents->size() <= UINT32_MAX) {
+    ssize_t read_size = read(fd, buffer, sizeof(buffer));
+    if (read_size < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    if (read_size == 0) break;
+    contents->append(buffer, read_size);
+  }
+  return true;
+}
+
+bool MappedFile::Open(const std::string &path, std::string *error) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    *error = path + ": " + strerror(errno);
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    *error = path + ": " + strerror(errno);
+    close(fd);
+    return false;
+  }
+  // Pipes and the files in /proc can not be mapped, and report a size of 0 even when they have
+  // contents, so they are read instead. This also covers empty files, for which `mmap` fails.
+  if (!S_ISREG(info.st_mode) || info.st_size == 0) {
+    bool read_all = ReadAll(fd, &contents_);
+    if (!read_all) {
+      *error = path + ": " + strerror(errno);
+    }
+    close(fd);
+    data_ = contents_.data();
+    size_ = contents_.size();
+    return read_all;
+  }
+  void *data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (data == MAP_FAILED) {
+    *error = path + ": " + strerror(errno);
+    close(fd);
+    return false;
+  }
+  data_ = static_cast<const char *>(data);
+  size_ = info.st_size;
+  mapped_ = true;
+  // The map stays valid without the file descriptor
+  close(fd);
+  return true;
+}
+
+void MappedFile::Advise(Advice advice) const {
+  if (mapped_) {
+    madvise(const_cast<char *>(data_), size_, advice == Advice::kSequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+  }
+}
+
+#else
+
+bool MappedFile::Open(const std::string &path, std::string *error) {
+  FILE *file = fopen(path.c_str(), "rb");
+  if (!file) {
+    *error = path + ": " + strerror(errno);
+    return false;
+  }
+  char buffer[1 << 16];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    contents_.append(buffer, read);
+  }
+  bool failed = ferror(file);
+  fclose(file);
+  if (failed) {
+    *error = path + ": could not be read";
+    return false;
+  }
+  data_ = contents_.data();
+  size_ = contents_.size();
+  return true;
+}
+
+void MappedFile::Advise(Advice) const {}
+
+#endif
+
+}  // namespace TreeSitterMarkdown
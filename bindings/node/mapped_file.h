@@ -0,0 +1,44 @@
+// Read-only memory maps of files, so that they can be parsed without copying them to the heap.
+#ifndef TREE_SITTER_MARKDOWN_BINDING_MAPPED_FILE_H_
+#define TREE_SITTER_MARKDOWN_BINDING_MAPPED_FILE_H_
+
+#include <cstddef>
+#include <string>
+
+namespace TreeSitterMarkdown {
+
+// A file mapped into memory. On Windows, and for files that are not regular files such as pipes,
+// the file is read into memory instead.
+//
+// The map is private, but if the file is truncated while it is mapped, reading the pages past its
+// new end raises SIGBUS. So the file must not be truncated until the map is destroyed.
+class MappedFile {
+ public:
+  // How the pages are going to be read. The block pass reads a document from start to end, the
+  // inline passes jump back to the start of each `inline` node.
+  enum class Advice { kSequential, kRandom };
+
+  MappedFile() = default;
+  ~MappedFile();
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  // Maps or reads the file at `path`, or returns false and describes why it could not in `error`
+  bool Open(const std::string &path, std::string *error);
+  // Only a hint, so failures are ignored
+  void Advise(Advice advice) const;
+
+  const char *data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  const char *data_ = "";
+  size_t size_ = 0;
+  bool mapped_ = false;
+  // The contents of the file where it can not be mapped
+  std::string contents_;
+};
+
+}  // namespace TreeSitterMarkdown
+
+#endif  // TREE_SITTER_MARKDOWN_BINDING_MAPPED_FILE_H_
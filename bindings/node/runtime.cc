@@ -0,0 +1,137 @@
+#include "runtime.h"
+#include <mutex>
+#include <tree_sitter/api.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+// The functions of tree_sitter/api.h that the addon calls, as `X(result, name, parameters,
+// arguments)`. A signature that does not match the header does not compile, because the
+// definitions below would conflict with its declarations.
+#define TREE_SITTER_MARKDOWN_RUNTIME_FUNCTIONS(X)                                                    \
+  X(TSParser *, ts_parser_new, (void), ())                                                           \
+  X(void, ts_parser_delete, (TSParser *self), (self))                                                \
+  X(bool, ts_parser_set_language, (TSParser *self, const TSLanguage *language), (self, language))    \
+  X(bool, ts_parser_set_included_ranges, (TSParser *self, const TSRange *ranges, uint32_t count),    \
+    (self, ranges, count))                                                                           \
+  X(TSTree *, ts_parser_parse_string,                                                                \
+    (TSParser *self, const TSTree *old_tree, const char *string, uint32_t length),                   \
+    (self, old_tree, string, length))                                                                \
+  X(TSTree *, ts_tree_copy, (const TSTree *self), (self))                                            \
+  X(void, ts_tree_delete, (TSTree *self), (self))                                                    \
+  X(TSNode, ts_tree_root_node, (const TSTree *self), (self))                                         \
+  X(void, ts_tree_edit, (TSTree *self, const TSInputEdit *edit), (self, edit))                       \
+  X(uint32_t, ts_node_start_byte, (TSNode node), (node))                                             \
+  X(uint32_t, ts_node_end_byte, (TSNode node), (node))                                               \
+  X(TSPoint, ts_node_start_point, (TSNode node), (node))                                             \
+  X(TSPoint, ts_node_end_point, (TSNode node), (node))                                               \
+  X(TSSymbol, ts_node_symbol, (TSNode node), (node))                                                 \
+  X(char *, ts_node_string, (TSNode node), (node))                                                   \
+  X(bool, ts_node_is_missing, (TSNode node), (node))                                                 \
+  X(bool, ts_node_has_error, (TSNode node), (node))                                                  \
+  X(uint32_t, ts_node_named_child_count, (TSNode node), (node))                                      \
+  X(TSNode, ts_node_named_child, (TSNode node, uint32_t index), (node, index))                       \
+  X(TSTreeCursor, ts_tree_cursor_new, (TSNode node), (node))                                         \
+  X(void, ts_tree_cursor_delete, (TSTreeCursor *self), (self))                                       \
+  X(void, ts_tree_cursor_reset, (TSTreeCursor *self, TSNode node), (self, node))                     \
+  X(TSNode, ts_tree_cursor_current_node, (const TSTreeCursor *self), (self))                         \
+  X(bool, ts_tree_cursor_goto_parent, (TSTreeCursor *self), (self))                                  \
+  X(bool, ts_tree_cursor_goto_next_sibling, (TSTreeCursor *self), (self))                            \
+  X(bool, ts_tree_cursor_goto_first_child, (TSTreeCursor *self), (self))                             \
+  X(uint32_t, ts_language_symbol_count, (const TSLanguage *self), (self))                            \
+  X(const char *, ts_language_symbol_name, (const TSLanguage *self, TSSymbol symbol), (self, symbol)) \
+  X(TSSymbolType, ts_language_symbol_type, (const TSLanguage *self, TSSymbol symbol), (self, symbol)) \
+  X(TSSymbol, ts_language_symbol_for_name,                                                           \
+    (const TSLanguage *self, const char *string, uint32_t length, bool is_named),                    \
+    (self, string, length, is_named))
+
+namespace {
+
+struct Runtime {
+#define TREE_SITTER_MARKDOWN_POINTER(result, name, parameters, arguments) result(*name) parameters = nullptr;
+  TREE_SITTER_MARKDOWN_RUNTIME_FUNCTIONS(TREE_SITTER_MARKDOWN_POINTER)
+#undef TREE_SITTER_MARKDOWN_POINTER
+};
+
+// Only written once, by `LoadRuntime`, before any parse can start
+Runtime runtime;
+std::mutex runtime_mutex;
+bool runtime_loaded = false;
+
+#ifdef _WIN32
+
+void *OpenLibrary(const std::string &path, std::string *error) {
+  int length = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+  std::wstring wide_path(length > 0 ? length : 1, L'\0');
+  MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &wide_path[0], length);
+  HMODULE library = LoadLibraryW(wide_path.c_str());
+  if (!library) {
+    *error = path + ": could not be loaded (error " + std::to_string(GetLastError()) + ")";
+  }
+  return library;
+}
+
+void *FindSymbol(void *library, const char *name) {
+  return reinterpret_cast<void *>(GetProcAddress(static_cast<HMODULE>(library), name));
+}
+
+#else
+
+void *OpenLibrary(const std::string &path, std::string *error) {
+  // The tree-sitter package has loaded its binary already, so this only returns its handle. The
+  // symbols stay local, so they do not replace those of other copies of tree-sitter.
+  void *library = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (!library) {
+    const char *message = dlerror();
+    *error = message ? message : path + ": could not be loaded";
+  }
+  return library;
+}
+
+void *FindSymbol(void *library, const char *name) {
+  return dlsym(library, name);
+}
+
+#endif
+
+}  // namespace
+
+namespace TreeSitterMarkdown {
+
+bool LoadRuntime(const std::string &path, std::string *error) {
+  std::lock_guard<std::mutex> lock(runtime_mutex);
+  if (runtime_loaded) {
+    return true;
+  }
+  // The library is never closed, as trees may live until the process exits
+  void *library = OpenLibrary(path, error);
+  if (!library) {
+    return false;
+  }
+  Runtime loaded;
+#define TREE_SITTER_MARKDOWN_RESOLVE(result, name, parameters, arguments)             \
+  loaded.name = reinterpret_cast<decltype(loaded.name)>(FindSymbol(library, #name)); \
+  if (!loaded.name) {                                                                \
+    *error = path + " does not export " #name;                                       \
+    return false;                                                                    \
+  }
+  TREE_SITTER_MARKDOWN_RUNTIME_FUNCTIONS(TREE_SITTER_MARKDOWN_RESOLVE)
+#undef TREE_SITTER_MARKDOWN_RESOLVE
+  runtime = loaded;
+  runtime_loaded = true;
+  return true;
+}
+
+}  // namespace TreeSitterMarkdown
+
+extern "C" {
+
+#define TREE_SITTER_MARKDOWN_FORWARD(result, name, parameters, arguments) \
+  result name parameters { return runtime.name arguments; }
+TREE_SITTER_MARKDOWN_RUNTIME_FUNCTIONS(TREE_SITTER_MARKDOWN_FORWARD)
+#undef TREE_SITTER_MARKDOWN_FORWARD
+
+}
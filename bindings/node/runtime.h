@@ -0,0 +1,19 @@
+// The tree-sitter runtime that the addon parses with. The addon does not contain a runtime of its
+// own, but uses the one in the binary of the tree-sitter package, so that trees and languages are
+// handled by the same code as in `Parser.setLanguage`.
+#ifndef TREE_SITTER_MARKDOWN_BINDING_RUNTIME_H_
+#define TREE_SITTER_MARKDOWN_BINDING_RUNTIME_H_
+
+#include <string>
+
+namespace TreeSitterMarkdown {
+
+// Loads the binary at `path` and resolves the functions of tree_sitter/api.h that the addon calls
+// in it. Before this succeeds, calling any of them crashes. Returns false and describes why in
+// `error` if the binary can not be loaded or does not export all functions. Loading again after a
+// success does nothing, even with another path.
+bool LoadRuntime(const std::string &path, std::string *error);
+
+}  // namespace TreeSitterMarkdown
+
+#endif  // TREE_SITTER_MARKDOWN_BINDING_RUNTIME_H_
@@ -1,6 +1,7 @@
 fn main() {
     let src_dir_block = std::path::Path::new("tree-sitter-markdown/src");
     let src_dir_inline = std::path::Path::new("tree-sitter-markdown-inline/src");
+    let common_dir = std::path::Path::new("common");
 
     let mut c_config = cc::Build::new();
     c_config.include(&src_dir_block);
@@ -10,6 +11,7 @@ fn main() {
         .flag_if_supported("-Wno-trigraphs");
     let parser_path = src_dir_block.join("parser.c");
     c_config.file(&parser_path);
+    configure_optimization(&mut c_config, false);
     c_config.compile("parser_block");
     println!("cargo:rerun-if-changed={}", parser_path.to_str().unwrap());
 
@@ -21,28 +23,112 @@ fn main() {
         .flag_if_supported("-Wno-trigraphs");
     let parser_path = src_dir_inline.join("parser.c");
     c_config.file(&parser_path);
+    configure_optimization(&mut c_config, false);
     c_config.compile("parser_inline");
     println!("cargo:rerun-if-changed={}", parser_path.to_str().unwrap());
 
     let mut cpp_config = cc::Build::new();
     cpp_config.cpp(true);
+    define_scanner_flags(&mut cpp_config);
     cpp_config.include(&src_dir_block);
     cpp_config
         .flag_if_supported("-Wno-unused-parameter")
         .flag_if_supported("-Wno-unused-but-set-variable");
     let scanner_path = src_dir_block.join("scanner.cc");
     cpp_config.file(&scanner_path);
+    configure_optimization(&mut cpp_config, true);
     cpp_config.compile("scanner_block");
     println!("cargo:rerun-if-changed={}", scanner_path.to_str().unwrap());
 
     let mut cpp_config = cc::Build::new();
     cpp_config.cpp(true);
+    define_scanner_flags(&mut cpp_config);
     cpp_config.include(&src_dir_inline);
     cpp_config
         .flag_if_supported("-Wno-unused-parameter")
         .flag_if_supported("-Wno-unused-but-set-variable");
     let scanner_path = src_dir_inline.join("scanner.cc");
     cpp_config.file(&scanner_path);
+    configure_optimization(&mut cpp_config, true);
     cpp_config.compile("scanner_inline");
     println!("cargo:rerun-if-changed={}", scanner_path.to_str().unwrap());
+    let unicode_path = src_dir_inline.join("unicode.h");
+    println!("cargo:rerun-if-changed={}", unicode_path.to_str().unwrap());
+
+    let common_scanner_path = common_dir.join("scanner.h");
+    println!("cargo:rerun-if-changed={}", common_scanner_path.to_str().unwrap());
+    let common_stats_path = common_dir.join("stats.h");
+    println!("cargo:rerun-if-changed={}", common_stats_path.to_str().unwrap());
+    for var in &[
+        "TREE_SITTER_MARKDOWN_LTO",
+        "TREE_SITTER_MARKDOWN_PGO",
+        "TREE_SITTER_MARKDOWN_PROFILE",
+    ] {
+        println!("cargo:rerun-if-env-changed={}", var);
+    }
+}
+
+/// Turns the features of this crate into preprocessor flags for the external scanners.
+fn define_scanner_flags(config: &mut cc::Build) {
+    if std::env::var_os("CARGO_FEATURE_SCANNER_STATS").is_some() {
+        config.define("TREE_SITTER_MARKDOWN_STATS", None);
+    }
+    if std::env::var_os("CARGO_FEATURE_SCANNER_STATS_CYCLES").is_some() {
+        config.define("TREE_SITTER_MARKDOWN_STATS_CYCLES", None);
+    }
+}
+
+/// Applies the opt-in optimizations that `benchmark/pgo.sh` measures. Both are off unless the
+/// environment asks for them, and both need clang so that the C and C++ code goes through the
+/// same LLVM passes and profile format as the Rust code:
+///
+/// * `TREE_SITTER_MARKDOWN_LTO=1` compiles to LLVM bitcode for ThinLTO across languages, which
+///   needs `-Clinker-plugin-lto` in `RUSTFLAGS` as well.
+/// * `TREE_SITTER_MARKDOWN_PGO=generate` instruments the code to write a profile into the
+///   directory `TREE_SITTER_MARKDOWN_PROFILE`, alongside `-Cprofile-generate` for the Rust code.
+/// * `TREE_SITTER_MARKDOWN_PGO=use` optimizes with the merged profile at
+///   `TREE_SITTER_MARKDOWN_PROFILE`, alongside `-Cprofile-use`.
+///
+/// A value that can not be applied stops the build instead of falling back to a plain one.
+fn configure_optimization(config: &mut cc::Build, cpp: bool) {
+    let lto = match std::env::var("TREE_SITTER_MARKDOWN_LTO").as_deref() {
+        Err(_) | Ok("") | Ok("0") => false,
+        Ok("1") => true,
+        Ok(other) => panic!("TREE_SITTER_MARKDOWN_LTO must be 0 or 1, not {}", other),
+    };
+    let pgo = std::env::var("TREE_SITTER_MARKDOWN_PGO").unwrap_or_default();
+    if !lto && pgo.is_empty() {
+        return;
+    }
+    if std::env::var_os(if cpp { "CXX" } else { "CC" }).is_none() {
+        config.compiler(if cpp { "clang++" } else { "clang" });
+    }
+    if !config.get_compiler().is_like_clang() {
+        panic!("TREE_SITTER_MARKDOWN_LTO and TREE_SITTER_MARKDOWN_PGO need clang");
+    }
+    if lto {
+        config.flag("-flto=thin");
+    }
+    let profile = || {
+        std::env::var("TREE_SITTER_MARKDOWN_PROFILE")
+            .expect("TREE_SITTER_MARKDOWN_PGO needs TREE_SITTER_MARKDOWN_PROFILE")
+    };
+    match pgo.as_str() {
+        "" => {}
+        "generate" => {
+            config.flag(&format!("-fprofile-generate={}", profile()));
+        }
+        "use" => {
+            let profile = profile();
+            if !std::path::Path::new(&profile).is_file() {
+                panic!("the profile {} does not exist", profile);
+            }
+            println!("cargo:rerun-if-changed={}", profile);
+            config.flag(&format!("-fprofile-use={}", profile));
+        }
+        other => panic!(
+            "TREE_SITTER_MARKDOWN_PGO must be generate or use, not {}",
+            other
+        ),
+    }
 }
@@ -13,14 +13,39 @@
 //! [tree-sitter]: https://tree-sitter.github.io/
 
 use std::collections::HashMap;
+use std::fs::File;
+use std::io;
+use std::path::Path;
 
-use tree_sitter::{InputEdit, Language, Node, Parser, Query, QueryCursor, Range, Tree};
+use tree_sitter::{InputEdit, Language, Node, Parser, Point, Query, QueryCursor, Range, Tree};
 
 extern "C" {
     fn tree_sitter_markdown() -> Language;
     fn tree_sitter_markdown_inline() -> Language;
 }
 
+mod memory;
+mod mmap;
+#[cfg(feature = "scanner-stats")]
+pub mod stats;
+#[cfg(feature = "trace")]
+pub mod trace;
+#[cfg(not(feature = "trace"))]
+mod trace {
+    /// Does nothing without the `trace` feature.
+    pub(crate) struct Span;
+
+    impl Span {
+        pub(crate) fn begin(_name: &str) -> Span {
+            Span
+        }
+
+        pub(crate) fn arg(&mut self, _key: &'static str, _value: u64) {}
+    }
+}
+
+pub use memory::MemoryUsage;
+
 /// Get the tree-sitter [Language][] for the block grammar.
 ///
 /// [Language]: https://docs.rs/tree-sitter/*/tree_sitter/struct.Language.html
@@ -136,6 +161,80 @@ impl MarkdownParser {
     ///  * The timeout set with [tree_sitter::Parser::set_timeout_micros] expired
     ///  * The cancellation flag set with [tree_sitter::Parser::set_cancellation_flag] was flipped
     pub fn parse(&mut self, text: &[u8], old_tree: Option<&MarkdownTree>) -> Option<MarkdownTree> {
+        let len = text.len();
+        self.parse_with(
+            &mut |byte, _| if byte < len { &text[byte..] } else { &[] },
+            old_tree,
+        )
+    }
+
+    /// Parse UTF8 text provided in chunks by a callback.
+    ///
+    /// This allows to parse documents that are not stored in one contiguous slice, e.g. files that
+    /// are too large to be read into memory at once.
+    ///
+    /// # Arguments:
+    /// * `callback` A function that takes a byte offset and position and returns a slice of UTF8
+    ///   text starting at that byte offset and position. The slices can be of any length. An empty
+    ///   slice marks the end of the document. The block grammar reads the document from start to
+    ///   end, but the inline grammar goes back to the start of every `inline` node, so the
+    ///   callback must be able to return text at any offset, not only at increasing ones.
+    /// * `old_tree` A previous syntax tree parsed from the same document.
+    ///   If the text of the document has changed since `old_tree` was
+    ///   created, then you must edit `old_tree` to match the new text using
+    ///   [MarkdownTree::edit].
+    ///
+    /// Returns `None` in the same cases as [MarkdownParser::parse].
+    pub fn parse_with<T: AsRef<[u8]>, F: FnMut(usize, Point) -> T>(
+        &mut self,
+        callback: &mut F,
+        old_tree: Option<&MarkdownTree>,
+    ) -> Option<MarkdownTree> {
+        self.parse_passes(callback, old_tree, || {})
+    }
+
+    /// Parse the UTF8 text of a file.
+    ///
+    /// The file is mapped into memory read-only and parsed in place, so it is never copied to the
+    /// heap. It must not be changed while it is parsed. The returned tree does not refer to the
+    /// file, so the map is dropped before this returns.
+    ///
+    /// The map is private, but that only hides writes made after a page is read. If another
+    /// process truncates the file during the parse, reading a page past its new end raises
+    /// `SIGBUS`, which kills the process. Parse the result of [std::fs::read] with
+    /// [MarkdownParser::parse] instead when files may be truncated concurrently.
+    ///
+    /// # Arguments:
+    /// * `path` The path of the file. It must be smaller than 4GiB, as tree-sitter counts bytes in
+    ///   32 bits.
+    /// * `old_tree` A previous syntax tree parsed from the same file, see [MarkdownParser::parse].
+    ///
+    /// Returns an error if the file could not be mapped, otherwise the result of
+    /// [MarkdownParser::parse].
+    pub fn parse_file<P: AsRef<Path>>(
+        &mut self,
+        path: P,
+        old_tree: Option<&MarkdownTree>,
+    ) -> io::Result<Option<MarkdownTree>> {
+        let map = mmap::Mmap::map(&File::open(path)?)?;
+        map.advise(mmap::Advice::Sequential);
+        let text: &[u8] = &map;
+        let len = text.len();
+        Ok(self.parse_passes(
+            &mut |byte, _| if byte < len { &text[byte..] } else { &[] },
+            old_tree,
+            || map.advise(mmap::Advice::Random),
+        ))
+    }
+
+    /// The block pass and the inline passes of [MarkdownParser::parse_with], with a call to
+    /// `before_inline` in between
+    fn parse_passes<T: AsRef<[u8]>, F: FnMut(usize, Point) -> T>(
+        &mut self,
+        callback: &mut F,
+        old_tree: Option<&MarkdownTree>,
+        before_inline: impl FnOnce(),
+    ) -> Option<MarkdownTree> {
         let MarkdownParser {
             parser,
             block_language,
@@ -143,13 +242,17 @@ impl MarkdownParser {
             inline_injection_query,
             query_cursor,
         } = self;
+        let mut parse_span = trace::Span::begin("parse");
         parser
             .set_included_ranges(&[])
             .expect("Can not set included ranges to whole document");
         parser
             .set_language(*block_language)
             .expect("Could not load block grammar");
-        let block_tree = parser.parse(text, old_tree.map(|tree| &tree.block_tree))?;
+        let block_span = trace::Span::begin("block");
+        let block_tree = parser.parse_with(callback, old_tree.map(|tree| &tree.block_tree))?;
+        drop(block_span);
+        parse_span.arg("bytes", block_tree.root_node().end_byte() as u64);
         let (mut inline_trees, mut inline_indices) = if let Some(old_tree) = old_tree {
             let len = old_tree.inline_trees.len();
             (Vec::with_capacity(len), HashMap::with_capacity(len))
@@ -160,8 +263,13 @@ impl MarkdownParser {
         parser
             .set_language(*inline_language)
             .expect("Could not load inline grammar");
+        before_inline();
+        let inline_span = trace::Span::begin("inline");
+        // The injection query has no predicates, so it never needs the text of a node
         for (i, capture) in query_cursor
-            .matches(inline_injection_query, block_tree.root_node(), text)
+            .matches(inline_injection_query, block_tree.root_node(), |_: Node| {
+                std::iter::empty()
+            })
             .flat_map(|query_match| query_match.captures)
             .enumerate()
         {
@@ -180,14 +288,30 @@ impl MarkdownParser {
                 range.start_point = child_range.end_point;
             }
             ranges.push(range);
+            // Looking up the parent and position of every range is not free, so only do it when
+            // it can be recorded
+            #[cfg(feature = "trace")]
+            let _range_span = {
+                let mut span = trace::Span::begin(
+                    capture
+                        .node
+                        .parent()
+                        .map_or("inline", |parent| parent.kind()),
+                );
+                span.arg("start_byte", capture.node.start_byte() as u64);
+                span.arg("end_byte", capture.node.end_byte() as u64);
+                span.arg("row", capture.node.start_position().row as u64);
+                span
+            };
             parser.set_included_ranges(&ranges).ok()?;
-            let inline_tree = parser.parse(
-                text,
+            let inline_tree = parser.parse_with(
+                callback,
                 old_tree.and_then(|old_tree| old_tree.inline_trees.get(i)),
             )?;
             inline_trees.push(inline_tree);
             inline_indices.insert(capture.node.id(), i);
         }
+        drop(inline_span);
         drop(tree_cursor);
         inline_trees.shrink_to_fit();
         inline_indices.shrink_to_fit();
@@ -199,10 +323,11 @@ impl MarkdownParser {
     }
 }
 
+#[cfg(all(test, feature = "scanner-stats"))]
+mod pathological_tests;
+
 #[cfg(test)]
 mod tests {
-    use tree_sitter::Point;
-
     use super::*;
 
     #[test]
@@ -217,6 +342,80 @@ mod tests {
             .expect("Error loading markdown language");
     }
 
+    #[test]
+    fn memory_usage() {
+        let mut parser = MarkdownParser::default();
+        let short = parser.parse(b"# title\n\n*a* b\n", None).unwrap();
+        let long = parser
+            .parse("# title\n\n*a* b\n".repeat(100).as_bytes(), None)
+            .unwrap();
+        let short = short.memory_usage();
+        let long = long.memory_usage();
+        assert!(short.block_tree > 0);
+        assert!(short.inline_trees > 0);
+        assert!(short.inline_indices > 0);
+        assert!(short.scanner_states > 0);
+        assert!(long.block_tree > 50 * short.block_tree);
+        assert!(long.inline_trees > 50 * short.inline_trees);
+        assert!(long.total() > 50 * short.total());
+    }
+
+    #[test]
+    fn parse_with_chunks() {
+        let code =
+            "# title\n\nInline [content] *with* `code`.\n\n> quoted\n> [link](url)\n".repeat(20);
+        let mut parser = MarkdownParser::default();
+        let expected = parser.parse(code.as_bytes(), None).unwrap();
+        let tree = parser
+            .parse_with(
+                &mut |byte, _| {
+                    let end = (byte + 7).min(code.len());
+                    code.as_bytes().get(byte..end).unwrap_or(&[])
+                },
+                None,
+            )
+            .unwrap();
+        assert_eq!(
+            tree.block_tree().root_node().to_sexp(),
+            expected.block_tree().root_node().to_sexp()
+        );
+        assert_eq!(tree.inline_trees.len(), expected.inline_trees.len());
+        for (inline_tree, expected) in tree.inline_trees.iter().zip(expected.inline_trees.iter()) {
+            assert_eq!(
+                inline_tree.root_node().to_sexp(),
+                expected.root_node().to_sexp()
+            );
+        }
+    }
+
+    #[test]
+    fn parse_file() {
+        let code = "# title\n\nInline [content] *with* `code`.\n\n> quoted\n> [link](url)\n";
+        let path = std::env::temp_dir().join(format!("tree-sitter-md-{}.md", std::process::id()));
+        std::fs::write(&path, code).unwrap();
+        let mut parser = MarkdownParser::default();
+        let tree = parser.parse_file(&path, None);
+        std::fs::remove_file(&path).unwrap();
+        let tree = tree.unwrap().unwrap();
+        let expected = parser.parse(code.as_bytes(), None).unwrap();
+        assert_eq!(
+            tree.block_tree().root_node().to_sexp(),
+            expected.block_tree().root_node().to_sexp()
+        );
+        assert_eq!(tree.inline_trees.len(), expected.inline_trees.len());
+        assert!(parser.parse_file(path, None).is_err());
+    }
+
+    #[test]
+    #[cfg(target_os = "linux")]
+    fn map_file_without_size() {
+        // Files in /proc report a size of 0 but have contents, so they have to be read
+        let path = "/proc/version";
+        let map = crate::mmap::Mmap::map(&std::fs::File::open(path).unwrap()).unwrap();
+        assert!(!map.is_empty());
+        assert_eq!(&map[..], &std::fs::read(path).unwrap()[..]);
+    }
+
     #[test]
     fn inline_ranges() {
         let code = "# title\n\nInline [content].\n";
@@ -0,0 +1,298 @@
+//! Estimates of the memory held by a [`MarkdownTree`].
+//!
+//! Tree-sitter does not report how much memory a tree uses, so it is estimated from the number
+//! and shape of the nodes. The sizes of the included ranges and of the scanner states are taken
+//! from tree-sitter's API and from the scanners. The sizes of tree-sitter's internal structures
+//! are not visible through its API, so they are an approximation: they are copied from the
+//! sources of tree-sitter 0.20 for 64 bit platforms, and a test fails when the crate moves to
+//! another version of tree-sitter without checking them again. Nodes that a grammar hides, like
+//! line endings, can not be seen through the tree-sitter API and are not counted, and neither is
+//! sharing of nodes between an old tree and the tree reparsed from it. So the estimate is a lower
+//! bound, but it grows with the real usage.
+
+use std::collections::HashMap;
+use std::mem::size_of;
+use std::os::raw::c_char;
+
+use tree_sitter::{ffi, Language, Node, Tree};
+
+use crate::{inline_language, language, MarkdownTree};
+
+extern "C" {
+    fn tree_sitter_markdown_external_scanner_create() -> *mut u8;
+    fn tree_sitter_markdown_external_scanner_serialize(
+        payload: *mut u8,
+        buffer: *mut c_char,
+    ) -> u32;
+    fn tree_sitter_markdown_external_scanner_destroy(payload: *mut u8);
+    fn tree_sitter_markdown_inline_external_scanner_create() -> *mut u8;
+    fn tree_sitter_markdown_inline_external_scanner_serialize(
+        payload: *mut u8,
+        buffer: *mut c_char,
+    ) -> u32;
+    fn tree_sitter_markdown_inline_external_scanner_destroy(payload: *mut u8);
+}
+
+/// `TSTree`: the root, the language and a pointer to the included ranges. Approximate.
+const TREE_SIZE: usize = 32;
+/// `TSRange`, for each included range of a tree
+const RANGE_SIZE: usize = size_of::<ffi::TSRange>();
+/// `SubtreeHeapData`, allocated for each node that does not fit into a `Subtree`. Approximate.
+const NODE_SIZE: usize = 80;
+/// `Subtree`, for each child of a node. Approximate.
+const CHILD_SIZE: usize = 8;
+/// Space for a scanner state inside of `SubtreeHeapData`. Longer states are allocated separately.
+/// Approximate.
+const EMBEDDED_STATE_SIZE: usize = 24;
+/// Bookkeeping of `malloc` for each allocation
+const ALLOCATION_OVERHEAD: usize = 16;
+
+/// Visible nodes of the block grammar that are tokens of the block scanner
+const BLOCK_SCANNER_TOKENS: &[&str] = &[
+    "block_continuation",
+    "block_quote_marker",
+    "atx_h1_marker",
+    "atx_h2_marker",
+    "atx_h3_marker",
+    "atx_h4_marker",
+    "atx_h5_marker",
+    "atx_h6_marker",
+    "setext_h1_underline",
+    "setext_h2_underline",
+    "fenced_code_block_delimiter",
+    "minus_metadata",
+    "plus_metadata",
+];
+
+/// Nodes of the block grammar that the block scanner keeps in `open_blocks`
+const BLOCK_SCANNER_OPEN_BLOCKS: &[&str] = &[
+    "block_quote",
+    "list_item",
+    "fenced_code_block",
+    "indented_code_block",
+];
+
+/// Visible nodes of the inline grammar that are tokens of the inline scanner
+const INLINE_SCANNER_TOKENS: &[&str] = &["code_span_delimiter", "emphasis_delimiter"];
+
+/// Length of the serialized state of a new block scanner, which has no open blocks
+fn block_scanner_state_size() -> usize {
+    unsafe {
+        let scanner = tree_sitter_markdown_external_scanner_create();
+        let mut buffer = [0; SERIALIZATION_BUFFER_SIZE];
+        let size = tree_sitter_markdown_external_scanner_serialize(scanner, buffer.as_mut_ptr());
+        tree_sitter_markdown_external_scanner_destroy(scanner);
+        size as usize
+    }
+}
+
+/// Length of a serialized inline scanner state, which is the same for all states
+fn inline_scanner_state_size() -> usize {
+    unsafe {
+        let scanner = tree_sitter_markdown_inline_external_scanner_create();
+        let mut buffer = [0; SERIALIZATION_BUFFER_SIZE];
+        let size =
+            tree_sitter_markdown_inline_external_scanner_serialize(scanner, buffer.as_mut_ptr());
+        tree_sitter_markdown_inline_external_scanner_destroy(scanner);
+        size as usize
+    }
+}
+
+/// `TREE_SITTER_SERIALIZATION_BUFFER_SIZE`, the space tree-sitter gives `serialize`
+const SERIALIZATION_BUFFER_SIZE: usize = 1024;
+
+/// Estimated memory used by a [`MarkdownTree`] in bytes. See [`MarkdownTree::memory_usage`].
+///
+/// This is an approximation based on the sizes of tree-sitter's internal structures, see the
+/// [module documentation](self).
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct MemoryUsage {
+    /// The nodes of the block tree.
+    pub block_tree: usize,
+    /// The nodes and included ranges of all inline trees.
+    pub inline_trees: usize,
+    /// The vector of inline trees and the map from `inline` nodes to their index in it.
+    pub inline_indices: usize,
+    /// The scanner states that tree-sitter keeps with every token of an external scanner, to be
+    /// able to restart the scanner there when reparsing. This is not part of `block_tree` or
+    /// `inline_trees`.
+    pub scanner_states: usize,
+}
+
+impl MemoryUsage {
+    pub fn total(&self) -> usize {
+        self.block_tree + self.inline_trees + self.inline_indices + self.scanner_states
+    }
+}
+
+impl std::ops::AddAssign for MemoryUsage {
+    fn add_assign(&mut self, other: MemoryUsage) {
+        self.block_tree += other.block_tree;
+        self.inline_trees += other.inline_trees;
+        self.inline_indices += other.inline_indices;
+        self.scanner_states += other.scanner_states;
+    }
+}
+
+impl MarkdownTree {
+    /// Estimates how much memory this tree uses, see [`MemoryUsage`].
+    ///
+    /// This walks all nodes of all trees, so it takes about as long as a query over the whole
+    /// document.
+    pub fn memory_usage(&self) -> MemoryUsage {
+        let block_scanner = Scanner::new(
+            language(),
+            BLOCK_SCANNER_TOKENS,
+            BLOCK_SCANNER_OPEN_BLOCKS,
+            block_scanner_state_size(),
+        );
+        let inline_scanner = Scanner::new(
+            inline_language(),
+            INLINE_SCANNER_TOKENS,
+            &[],
+            inline_scanner_state_size(),
+        );
+        let inline_kind = language().id_for_node_kind("inline", true);
+        let mut usage = MemoryUsage::default();
+
+        let mut inline_ranges = 0;
+        let (nodes, states) = estimate_tree(&self.block_tree, &block_scanner, |node| {
+            if node.kind_id() == inline_kind && self.inline_indices.contains_key(&node.id()) {
+                inline_ranges += node.named_child_count() + 1;
+            }
+        });
+        usage.block_tree = nodes;
+        usage.scanner_states = states;
+
+        usage.inline_trees =
+            inline_ranges * RANGE_SIZE + self.inline_trees.len() * ALLOCATION_OVERHEAD;
+        for tree in &self.inline_trees {
+            let (nodes, states) = estimate_tree(tree, &inline_scanner, |_| ());
+            usage.inline_trees += nodes;
+            usage.scanner_states += states;
+        }
+
+        usage.inline_indices = self.inline_trees.capacity() * size_of::<Tree>()
+            + hash_map_size(&self.inline_indices)
+            + 2 * ALLOCATION_OVERHEAD;
+        usage
+    }
+}
+
+/// The node kinds of a grammar that matter for the scanner states.
+struct Scanner {
+    tokens: Vec<u16>,
+    open_blocks: Vec<u16>,
+    state_size: usize,
+}
+
+impl Scanner {
+    fn new(language: Language, tokens: &[&str], open_blocks: &[&str], state_size: usize) -> Self {
+        let ids = |kinds: &[&str]| {
+            kinds
+                .iter()
+                .map(|kind| language.id_for_node_kind(kind, true))
+                .collect()
+        };
+        Scanner {
+            tokens: ids(tokens),
+            open_blocks: ids(open_blocks),
+            state_size,
+        }
+    }
+}
+
+/// Returns the estimated size of the nodes of `tree` and of the scanner states in it, and calls
+/// `visit` for every node.
+fn estimate_tree<F: FnMut(&Node)>(tree: &Tree, scanner: &Scanner, mut visit: F) -> (usize, usize) {
+    let mut nodes = TREE_SIZE + ALLOCATION_OVERHEAD;
+    let mut states = 0;
+    let mut open_blocks = 0;
+    let mut previous_end = 0;
+    let mut cursor = tree.walk();
+    loop {
+        let node = cursor.node();
+        visit(&node);
+        let child_count = node.child_count();
+        if child_count > 0 {
+            // The children are allocated together with their parent
+            nodes += NODE_SIZE + child_count * CHILD_SIZE + ALLOCATION_OVERHEAD;
+        } else {
+            if scanner.tokens.contains(&node.kind_id()) {
+                nodes += NODE_SIZE - EMBEDDED_STATE_SIZE + ALLOCATION_OVERHEAD;
+                let state_size = scanner.state_size + open_blocks;
+                states += EMBEDDED_STATE_SIZE;
+                if state_size > EMBEDDED_STATE_SIZE {
+                    states += state_size + ALLOCATION_OVERHEAD;
+                }
+            } else if !is_inline_leaf(&node, previous_end) {
+                nodes += NODE_SIZE + ALLOCATION_OVERHEAD;
+            }
+            previous_end = node.end_byte();
+        }
+
+        if cursor.goto_first_child() {
+            if scanner.open_blocks.contains(&node.kind_id()) {
+                open_blocks += 1;
+            }
+            continue;
+        }
+        while !cursor.goto_next_sibling() {
+            if !cursor.goto_parent() {
+                return (nodes, states);
+            }
+            if scanner.open_blocks.contains(&cursor.node().kind_id()) {
+                open_blocks -= 1;
+            }
+        }
+    }
+}
+
+/// Whether tree-sitter stores a leaf directly in its parent's list of children instead of
+/// allocating it, see `ts_subtree_new_leaf`.
+fn is_inline_leaf(node: &Node, previous_end: usize) -> bool {
+    let padding = node.start_byte().saturating_sub(previous_end);
+    let size = node.end_byte() - node.start_byte();
+    node.kind_id() <= u8::MAX as u16
+        && padding < u8::MAX as usize
+        && size < u8::MAX as usize
+        && node.start_position().row == node.end_position().row
+}
+
+/// The size of the table of a `HashMap`, which allocates a power of two buckets for a load factor
+/// of 7/8, with one control byte per bucket plus a group of 16.
+fn hash_map_size<K, V>(map: &HashMap<K, V>) -> usize {
+    if map.capacity() == 0 {
+        return 0;
+    }
+    let buckets = (map.capacity() * 8 / 7).next_power_of_two();
+    buckets * (size_of::<(K, V)>() + 1) + 16
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn approximate_sizes_are_from_the_tree_sitter_in_use() {
+        /// The version of tree-sitter that the approximate sizes are taken from
+        const APPROXIMATED_VERSION: &str = "~0.20";
+
+        // The sizes of the internal structures of tree-sitter are copied from its sources, so they
+        // have to be checked again for every new version of tree-sitter
+        let manifest = include_str!(concat!(env!("CARGO_MANIFEST_DIR"), "/Cargo.toml"));
+        assert!(
+            manifest.contains(&format!("tree-sitter = \"{}\"", APPROXIMATED_VERSION)),
+            "check the sizes in memory.rs against the new version of tree-sitter"
+        );
+    }
+
+    #[test]
+    fn sizes_from_the_runtime() {
+        assert_eq!(RANGE_SIZE, 24);
+        // A state longer than `EMBEDDED_STATE_SIZE` is allocated separately, which is why its
+        // size matters
+        assert_eq!(block_scanner_state_size(), 5);
+        assert_eq!(inline_scanner_state_size(), 6);
+    }
+}
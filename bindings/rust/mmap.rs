@@ -0,0 +1,155 @@
+//! Read-only memory maps of files for [`MarkdownParser::parse_file`].
+//!
+//! The block pass reads a document once from start to end, while the inline passes jump back to
+//! the start of each `inline` node. So the map is advised as sequential before the block pass,
+//! which lets the kernel read ahead aggressively, and as random before the inline passes, whose
+//! pages are mostly still in the page cache and should not pull in more around them.
+//!
+//! The map is `MAP_PRIVATE`, which does not protect against a file that is truncated while it is
+//! mapped: the pages past its new end raise `SIGBUS` when they are read. Catching that signal
+//! would need a process-wide handler, so it is left to the callers to not truncate files while
+//! they are parsed.
+//!
+//! On platforms without `mmap`, and for pipes, the files in `/proc` and other files that can not
+//! be mapped, the file is read into memory instead.
+//!
+//! [`MarkdownParser::parse_file`]: crate::MarkdownParser::parse_file
+
+use std::fs::File;
+use std::io;
+use std::ops::Deref;
+
+/// Reads a file that can not be mapped. Stops once the file is larger than any document can be, so
+/// that a device without an end does not fill the memory.
+fn read(file: &File) -> io::Result<Vec<u8>> {
+    use std::io::Read;
+
+    let mut contents = Vec::new();
+    file.take(u32::MAX as u64 + 1).read_to_end(&mut contents)?;
+    if contents.len() > u32::MAX as usize {
+        return Err(too_large());
+    }
+    Ok(contents)
+}
+
+fn too_large() -> io::Error {
+    io::Error::new(
+        io::ErrorKind::InvalidInput,
+        "documents must be smaller than 4GiB",
+    )
+}
+
+/// How the pages of a [`Mmap`] are going to be accessed
+#[derive(Debug, Clone, Copy)]
+pub(crate) enum Advice {
+    Sequential,
+    Random,
+}
+
+#[cfg(unix)]
+pub(crate) struct Mmap {
+    /// Null if the file was read into `contents` instead
+    ptr: *mut libc::c_void,
+    len: usize,
+    contents: Vec<u8>,
+}
+
+#[cfg(unix)]
+impl Mmap {
+    pub(crate) fn map(file: &File) -> io::Result<Mmap> {
+        use std::os::unix::io::AsRawFd;
+
+        let metadata = file.metadata()?;
+        // Pipes and the files in `/proc` can not be mapped, and report a size of 0 even when they
+        // have contents, so they are read instead. This also covers empty files, for which `mmap`
+        // fails.
+        if !metadata.file_type().is_file() || metadata.len() == 0 {
+            return Ok(Mmap {
+                ptr: std::ptr::null_mut(),
+                len: 0,
+                contents: read(file)?,
+            });
+        }
+        let len = metadata.len();
+        if len > u32::MAX as u64 {
+            return Err(too_large());
+        }
+        let len = len as usize;
+        let ptr = unsafe {
+            libc::mmap(
+                std::ptr::null_mut(),
+                len,
+                libc::PROT_READ,
+                libc::MAP_PRIVATE,
+                file.as_raw_fd(),
+                0,
+            )
+        };
+        if ptr == libc::MAP_FAILED {
+            return Err(io::Error::last_os_error());
+        }
+        Ok(Mmap {
+            ptr,
+            len,
+            contents: Vec::new(),
+        })
+    }
+
+    /// Only a hint, so failures are ignored
+    pub(crate) fn advise(&self, advice: Advice) {
+        if self.ptr.is_null() {
+            return;
+        }
+        let advice = match advice {
+            Advice::Sequential => libc::MADV_SEQUENTIAL,
+            Advice::Random => libc::MADV_RANDOM,
+        };
+        unsafe {
+            libc::madvise(self.ptr, self.len, advice);
+        }
+    }
+}
+
+#[cfg(unix)]
+impl Deref for Mmap {
+    type Target = [u8];
+
+    fn deref(&self) -> &[u8] {
+        if self.ptr.is_null() {
+            return &self.contents;
+        }
+        unsafe { std::slice::from_raw_parts(self.ptr as *const u8, self.len) }
+    }
+}
+
+#[cfg(unix)]
+impl Drop for Mmap {
+    fn drop(&mut self) {
+        if !self.ptr.is_null() {
+            unsafe {
+                libc::munmap(self.ptr, self.len);
+            }
+        }
+    }
+}
+
+#[cfg(not(unix))]
+pub(crate) struct Mmap(Vec<u8>);
+
+#[cfg(not(unix))]
+impl Mmap {
+    pub(crate) fn map(file: &File) -> io::Result<Mmap> {
+        Ok(Mmap(read(file)?))
+    }
+
+    pub(crate) fn advise(&self, _advice: Advice) {}
+}
+
+#[cfg(not(unix))]
+impl Deref for Mmap {
+    type Target = [u8];
+
+    fn deref(&self) -> &[u8] {
+        &self.0
+    }
+}
@@ -0,0 +1,147 @@
+//! Regression tests for inputs that used to make parsing blow up, modelled on the pathological
+//! tests of [cmark](https://github.com/commonmark/cmark/blob/master/test/pathological_tests.py).
+//!
+//! Every case generates an input of two different sizes and checks that the work per byte does not
+//! grow with the size of the input. The work is counted by the external scanners: every scan the
+//! parser requests, which grows with the number of parse branches, plus every character a scan
+//! advanced. Both are exact, so unlike timings they do not depend on the machine. The tests need
+//! the `scanner-stats` feature, e.g. `cargo test --features scanner-stats`.
+
+use super::*;
+
+/// Number of repetitions of the pattern in the smaller input.
+const BASE_REPETITIONS: usize = 1000;
+/// The larger input repeats the pattern this many times more often.
+const SCALE: usize = 4;
+/// Maximal allowed growth of the work per byte. Linear scaling gives 1, quadratic scaling would
+/// give about `SCALE`.
+const MAX_RATIO: f64 = 2.0;
+
+/// Scans plus characters advanced by the external scanners per byte of `source`.
+fn work_per_byte(source: &str) -> f64 {
+    stats::reset();
+    MarkdownParser::default()
+        .parse(source.as_bytes(), None)
+        .expect("Parsing did not succeed");
+    let work: u64 = stats::block()
+        .iter()
+        .chain(stats::inline().iter())
+        .map(|token| token.emitted + token.advanced)
+        .sum();
+    work as f64 / source.len().max(1) as f64
+}
+
+fn assert_near_linear(name: &str, generate: fn(usize) -> String) {
+    let small = generate(BASE_REPETITIONS);
+    let large = generate(BASE_REPETITIONS * SCALE);
+    let small_work = work_per_byte(&small);
+    let large_work = work_per_byte(&large);
+    let ratio = large_work / small_work;
+    assert!(
+        ratio < MAX_RATIO,
+        "{}: work per byte grew {:.1}x from {} to {} bytes",
+        name,
+        ratio,
+        small.len(),
+        large.len()
+    );
+}
+
+#[test]
+fn nested_strong_emphasis() {
+    assert_near_linear("nested strong emphasis", |n| {
+        "*a **a ".repeat(n) + "b" + &" a** a*".repeat(n)
+    });
+}
+
+#[test]
+fn many_emphasis_closers_without_openers() {
+    assert_near_linear("many emphasis closers without openers", |n| "a_ ".repeat(n));
+}
+
+#[test]
+fn many_emphasis_openers_without_closers() {
+    assert_near_linear("many emphasis openers without closers", |n| "_a ".repeat(n));
+}
+
+#[test]
+fn mismatched_openers_and_closers() {
+    assert_near_linear("mismatched openers and closers", |n| "*a_ ".repeat(n));
+}
+
+#[test]
+fn openers_and_closers_multiple_of_3() {
+    assert_near_linear("openers and closers multiple of 3", |n| {
+        "a**b".to_string() + &"c* ".repeat(n)
+    });
+}
+
+#[test]
+fn long_delimiter_runs() {
+    assert_near_linear("long delimiter runs", |n| {
+        "a".to_string() + &"*".repeat(n) + "b" + &"_".repeat(n) + "c" + &"~".repeat(n)
+    });
+}
+
+#[test]
+fn long_delimiter_run_between_spaces() {
+    assert_near_linear("long delimiter run between spaces", |n| {
+        "a ".to_string() + &"*".repeat(n) + " b"
+    });
+}
+
+#[test]
+fn nested_brackets() {
+    assert_near_linear("nested brackets", |n| {
+        "[".repeat(n) + "a" + &"]".repeat(n)
+    });
+}
+
+#[test]
+fn many_link_openers_without_closers() {
+    assert_near_linear("many link openers without closers", |n| "[a".repeat(n));
+}
+
+#[test]
+fn many_link_closers_without_openers() {
+    assert_near_linear("many link closers without openers", |n| "a]".repeat(n));
+}
+
+#[test]
+fn unclosed_links() {
+    assert_near_linear("unclosed links", |n| "[a](<b".repeat(n) + &"[a](b".repeat(n));
+}
+
+#[test]
+fn link_openers_and_emphasis_closers() {
+    assert_near_linear("link openers and emphasis closers", |n| "[ a_".repeat(n));
+}
+
+/// Every run searches the rest of the paragraph for a closing run of its length and finds none.
+/// Runs longer than 255 backticks are never searched, so the work per byte approaches 255 once
+/// the runs get that long.
+#[test]
+fn backticks_of_increasing_length() {
+    assert_near_linear("backticks of increasing length", |n| {
+        (1..=n / 4).map(|i| "e".to_string() + &"`".repeat(i)).collect()
+    });
+}
+
+#[test]
+fn long_backtick_run() {
+    assert_near_linear("long backtick run", |n| {
+        "a".to_string() + &"`".repeat(n) + "b" + &"`".repeat(n)
+    });
+}
+
+#[test]
+fn nested_block_quotes() {
+    assert_near_linear("nested block quotes", |n| ">".repeat(n / 10) + "a\n");
+}
+
+#[test]
+fn deeply_nested_lists() {
+    assert_near_linear("deeply nested lists", |n| {
+        (0..n / 20).map(|i| "  ".repeat(i) + "* a\n").collect()
+    });
+}
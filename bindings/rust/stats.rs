@@ -0,0 +1,185 @@
+//! Counters from the external scanners, to find out which scanner paths dominate a parse.
+//!
+//! Only available with the `scanner-stats` feature, which compiles the counting into the
+//! scanners. Counters are kept per thread and accumulate over all parses on that thread until
+//! [`reset`] is called.
+
+use std::ffi::CStr;
+use std::fmt::Write;
+use std::os::raw::c_char;
+
+/// Number of buckets of [`TokenStats::lookahead`].
+pub const LOOKAHEAD_BUCKETS: usize = 16;
+
+#[repr(C)]
+struct RawTokenStats {
+    name: *const c_char,
+    valid: u64,
+    emitted: u64,
+    simulated: u64,
+    advanced: u64,
+    cycles: u64,
+    max_lookahead: u64,
+    lookahead: [u64; LOOKAHEAD_BUCKETS],
+}
+
+extern "C" {
+    fn tree_sitter_markdown_scanner_stats(count: *mut u32) -> *const RawTokenStats;
+    fn tree_sitter_markdown_inline_scanner_stats(count: *mut u32) -> *const RawTokenStats;
+    fn tree_sitter_markdown_scanner_stats_reset();
+    fn tree_sitter_markdown_inline_scanner_stats_reset();
+}
+
+/// Counters for one external token.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct TokenStats {
+    /// The name of the token in the `TokenType` enum of the scanner. Scans that did not produce
+    /// a token are counted under `(none)`.
+    pub name: &'static str,
+    /// Scans in which this token was valid.
+    pub valid: u64,
+    /// Scans that produced this token.
+    pub emitted: u64,
+    /// How many of `emitted` were simulated by the block scanner itself, e.g. to decide whether a
+    /// line break ends a paragraph.
+    pub simulated: u64,
+    /// Characters advanced during the scans in `emitted`, including lookahead past the token.
+    pub advanced: u64,
+    /// Cpu cycles spent in the scans in `emitted`. Always 0 without the `scanner-stats-cycles`
+    /// feature.
+    pub cycles: u64,
+    /// The longest lookahead, in characters past the end of the token, of the scans in `emitted`
+    /// that were requested by the parser.
+    pub max_lookahead: u64,
+    /// Histogram of the lookahead of the scans in `emitted` that were requested by the parser.
+    /// Bucket 0 counts scans without lookahead, bucket `i` scans with a lookahead in
+    /// `2^(i-1)..2^i` and the last bucket everything longer.
+    ///
+    /// Tree-sitter re-lexes a token whenever an edit touches its lookahead, so a long tail here
+    /// makes incremental parsing slow.
+    pub lookahead: [u64; LOOKAHEAD_BUCKETS],
+}
+
+fn read(raw: unsafe extern "C" fn(*mut u32) -> *const RawTokenStats) -> Vec<TokenStats> {
+    unsafe {
+        let mut count = 0;
+        let stats = raw(&mut count);
+        std::slice::from_raw_parts(stats, count as usize)
+            .iter()
+            .map(|raw| TokenStats {
+                name: CStr::from_ptr(raw.name).to_str().unwrap(),
+                valid: raw.valid,
+                emitted: raw.emitted,
+                simulated: raw.simulated,
+                advanced: raw.advanced,
+                cycles: raw.cycles,
+                max_lookahead: raw.max_lookahead,
+                lookahead: raw.lookahead,
+            })
+            .collect()
+    }
+}
+
+/// The counters of the block scanner on the current thread.
+pub fn block() -> Vec<TokenStats> {
+    read(tree_sitter_markdown_scanner_stats)
+}
+
+/// The counters of the inline scanner on the current thread.
+pub fn inline() -> Vec<TokenStats> {
+    read(tree_sitter_markdown_inline_scanner_stats)
+}
+
+/// Sets the counters of both scanners on the current thread to 0.
+pub fn reset() {
+    unsafe {
+        tree_sitter_markdown_scanner_stats_reset();
+        tree_sitter_markdown_inline_scanner_stats_reset();
+    }
+}
+
+/// Formats the counters of both scanners as a table, with the tokens that advanced the most
+/// characters first, followed by the lookahead histograms. Tokens that were never emitted are
+/// left out.
+pub fn report() -> String {
+    let mut out = String::new();
+    let scanners = vec![("block", block()), ("inline", inline())];
+    for (scanner, stats) in &scanners {
+        let mut stats: Vec<&TokenStats> = stats.iter().filter(|token| token.emitted > 0).collect();
+        stats.sort_by(|a, b| (b.advanced, b.cycles).cmp(&(a.advanced, a.cycles)));
+        writeln!(
+            out,
+            "{:<7} {:<40} {:>10} {:>10} {:>10} {:>12} {:>14}",
+            scanner, "token", "valid", "emitted", "simulated", "advanced", "cycles"
+        )
+        .unwrap();
+        for token in stats {
+            writeln!(
+                out,
+                "{:<7} {:<40} {:>10} {:>10} {:>10} {:>12} {:>14}",
+                "",
+                token.name,
+                token.valid,
+                token.emitted,
+                token.simulated,
+                token.advanced,
+                token.cycles
+            )
+            .unwrap();
+        }
+    }
+    for (scanner, stats) in &scanners {
+        write!(out, "\n{:<7} {:<40} {:>8}", scanner, "lookahead", "max").unwrap();
+        for bucket in 0..LOOKAHEAD_BUCKETS {
+            write!(out, " {:>7}", bucket_label(bucket)).unwrap();
+        }
+        out.push('\n');
+        let mut stats: Vec<&TokenStats> = stats
+            .iter()
+            .filter(|token| token.max_lookahead > 0)
+            .collect();
+        stats.sort_by(|a, b| b.max_lookahead.cmp(&a.max_lookahead));
+        for token in stats {
+            write!(
+                out,
+                "{:<7} {:<40} {:>8}",
+                "", token.name, token.max_lookahead
+            )
+            .unwrap();
+            for count in token.lookahead.iter() {
+                write!(out, " {:>7}", count).unwrap();
+            }
+            out.push('\n');
+        }
+    }
+    out
+}
+
+/// The smallest lookahead counted in `bucket`.
+fn bucket_label(bucket: usize) -> String {
+    match bucket {
+        0 => "0".to_string(),
+        _ if bucket == LOOKAHEAD_BUCKETS - 1 => format!("{}+", 1u64 << (bucket - 1)),
+        _ => (1u64 << (bucket - 1)).to_string(),
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn counters_are_named() {
+        reset();
+        let block = block();
+        let inline = inline();
+        assert_eq!(block.first().unwrap().name, "LINE_ENDING");
+        assert_eq!(inline.first().unwrap().name, "ERROR");
+        for stats in [block, inline].iter() {
+            assert_eq!(stats.last().unwrap().name, "(none)");
+            assert!(stats
+                .iter()
+                .all(|token| token.valid == 0 && token.emitted == 0));
+        }
+    }
+}
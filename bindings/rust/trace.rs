@@ -0,0 +1,302 @@
+//! Records where the time of a parse goes, as a [Chrome trace][trace event format].
+//!
+//! Only available with the `trace` feature, which implies `scanner-stats`. Call [`start`] before
+//! parsing and [`stop`] afterwards, and load the JSON of the returned [`Trace`] into
+//! `chrome://tracing` or <https://ui.perfetto.dev>.
+//!
+//! Each call of [`MarkdownParser::parse`](crate::MarkdownParser::parse) is recorded as a span
+//! with one span for the block tree and one for all inline trees inside of it. Each inline tree
+//! gets a span of its own, named after the block that contains it, like `paragraph` or
+//! `pipe_table_cell`. All spans count the scans of the external scanners in them and the time
+//! these took. Scans that took longer than the threshold passed to [`start`] get a span of
+//! their own as well, named after the token they produced.
+//!
+//! Recording is per thread.
+//!
+//! [trace event format]: https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU
+
+use std::cell::RefCell;
+use std::ffi::CStr;
+use std::fmt::Write;
+use std::os::raw::{c_char, c_void};
+use std::time::{Duration, Instant};
+
+#[repr(C)]
+struct ScanTracer {
+    begin: Option<extern "C" fn(*mut c_void)>,
+    end: Option<extern "C" fn(*mut c_void, *const c_char, *const c_char)>,
+    payload: *mut c_void,
+}
+
+extern "C" {
+    fn tree_sitter_markdown_scanner_trace(tracer: *const ScanTracer);
+}
+
+/// A recorded span.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct Event {
+    pub name: String,
+    /// `markdown` for the phases of a parse, or the scanner for a single scan
+    pub category: &'static str,
+    /// The start of the span, relative to the call of [`start`]
+    pub start: Duration,
+    pub duration: Duration,
+    pub args: Vec<(&'static str, u64)>,
+}
+
+/// All spans recorded between [`start`] and [`stop`], in the order they ended.
+#[derive(Debug, Clone, Default)]
+pub struct Trace {
+    pub events: Vec<Event>,
+}
+
+impl Trace {
+    /// The trace in the JSON object format of Chrome traces.
+    pub fn to_json(&self) -> String {
+        let mut out = String::from("{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+        for (i, event) in self.events.iter().enumerate() {
+            write!(
+                out,
+                "{{\"name\": \"{}\", \"cat\": \"{}\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, \
+                 \"ts\": {:.3}, \"dur\": {:.3}, \"args\": {{",
+                event.name.replace('\\', "\\\\").replace('"', "\\\""),
+                event.category,
+                event.start.as_nanos() as f64 / 1e3,
+                event.duration.as_nanos() as f64 / 1e3
+            )
+            .unwrap();
+            for (j, (key, value)) in event.args.iter().enumerate() {
+                let separator = if j > 0 { ", " } else { "" };
+                write!(out, "{}\"{}\": {}", separator, key, value).unwrap();
+            }
+            out.push_str(if i + 1 < self.events.len() {
+                "}},\n"
+            } else {
+                "}}\n"
+            });
+        }
+        out.push_str("]}\n");
+        out
+    }
+}
+
+struct OpenSpan {
+    name: String,
+    category: &'static str,
+    start: Instant,
+    args: Vec<(&'static str, u64)>,
+    scans: u64,
+    scan_time: Duration,
+}
+
+struct Recorder {
+    epoch: Instant,
+    scan_threshold: Duration,
+    scan_start: Option<Instant>,
+    open: Vec<OpenSpan>,
+    events: Vec<Event>,
+}
+
+impl Recorder {
+    fn close(&mut self, span: OpenSpan, end: Instant) {
+        self.events.push(Event {
+            name: span.name,
+            category: span.category,
+            start: span.start - self.epoch,
+            duration: end - span.start,
+            args: span.args,
+        });
+    }
+}
+
+thread_local! {
+    static RECORDER: RefCell<Option<Recorder>> = RefCell::new(None);
+}
+
+/// Starts recording on the current thread, discarding anything recorded before.
+///
+/// Scans of the external scanners that take at least `scan_threshold` are recorded as spans of
+/// their own.
+pub fn start(scan_threshold: Duration) {
+    RECORDER.with(|recorder| {
+        *recorder.borrow_mut() = Some(Recorder {
+            epoch: Instant::now(),
+            scan_threshold,
+            scan_start: None,
+            open: Vec::new(),
+            events: Vec::new(),
+        })
+    });
+    let tracer = ScanTracer {
+        begin: Some(scan_begin),
+        end: Some(scan_end),
+        payload: std::ptr::null_mut(),
+    };
+    unsafe { tree_sitter_markdown_scanner_trace(&tracer) };
+}
+
+/// Stops recording on the current thread and returns what was recorded since [`start`].
+pub fn stop() -> Trace {
+    unsafe { tree_sitter_markdown_scanner_trace(std::ptr::null()) };
+    let recorder = RECORDER.with(|recorder| recorder.borrow_mut().take());
+    let mut recorder = match recorder {
+        Some(recorder) => recorder,
+        None => return Trace::default(),
+    };
+    let now = Instant::now();
+    while let Some(span) = recorder.open.pop() {
+        recorder.close(span, now);
+    }
+    Trace {
+        events: recorder.events,
+    }
+}
+
+extern "C" fn scan_begin(_payload: *mut c_void) {
+    RECORDER.with(|recorder| {
+        if let Some(recorder) = recorder.borrow_mut().as_mut() {
+            recorder.scan_start = Some(Instant::now());
+        }
+    });
+}
+
+extern "C" fn scan_end(_payload: *mut c_void, scanner: *const c_char, token: *const c_char) {
+    let end = Instant::now();
+    RECORDER.with(|recorder| {
+        let mut recorder = recorder.borrow_mut();
+        let recorder = match recorder.as_mut() {
+            Some(recorder) => recorder,
+            None => return,
+        };
+        let start = match recorder.scan_start.take() {
+            Some(start) => start,
+            None => return,
+        };
+        let duration = end - start;
+        for span in recorder.open.iter_mut() {
+            span.scans += 1;
+            span.scan_time += duration;
+        }
+        if duration >= recorder.scan_threshold {
+            let (scanner, token) = unsafe {
+                (
+                    CStr::from_ptr(scanner).to_str().unwrap_or("?"),
+                    CStr::from_ptr(token).to_string_lossy(),
+                )
+            };
+            let category = if scanner == "block" {
+                "block scanner"
+            } else {
+                "inline scanner"
+            };
+            recorder.events.push(Event {
+                name: token.into_owned(),
+                category,
+                start: start - recorder.epoch,
+                duration,
+                args: vec![],
+            });
+        }
+    });
+}
+
+/// A span of a parse, recorded from its creation until it is dropped if a trace is running.
+pub(crate) struct Span {
+    /// The index of the span in `Recorder::open`, or `None` if no trace was running
+    index: Option<usize>,
+}
+
+impl Span {
+    pub(crate) fn begin(name: &str) -> Span {
+        let index = RECORDER.with(|recorder| match recorder.borrow_mut().as_mut() {
+            Some(recorder) => {
+                recorder.open.push(OpenSpan {
+                    name: name.to_string(),
+                    category: "markdown",
+                    start: Instant::now(),
+                    args: Vec::new(),
+                    scans: 0,
+                    scan_time: Duration::default(),
+                });
+                Some(recorder.open.len() - 1)
+            }
+            None => None,
+        });
+        Span { index }
+    }
+
+    /// Adds an argument to this span, even if spans inside of it are still open.
+    pub(crate) fn arg(&mut self, key: &'static str, value: u64) {
+        let index = match self.index {
+            Some(index) => index,
+            None => return,
+        };
+        RECORDER.with(|recorder| {
+            if let Some(span) = recorder
+                .borrow_mut()
+                .as_mut()
+                .and_then(|recorder| recorder.open.get_mut(index))
+            {
+                span.args.push((key, value));
+            }
+        });
+    }
+}
+
+impl Drop for Span {
+    fn drop(&mut self) {
+        let index = match self.index {
+            Some(index) => index,
+            None => return,
+        };
+        let end = Instant::now();
+        RECORDER.with(|recorder| {
+            if let Some(recorder) = recorder.borrow_mut().as_mut() {
+                // Spans are dropped in the reverse order of their creation, so this is the last
+                // open span unless the trace was restarted in between
+                if index < recorder.open.len() {
+                    let mut span = recorder.open.remove(index);
+                    span.args.push(("scans", span.scans));
+                    span.args
+                        .push(("scan_ns", span.scan_time.as_nanos() as u64));
+                    recorder.close(span, end);
+                }
+            }
+        });
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn records_nested_spans() {
+        start(Duration::from_secs(1));
+        {
+            let mut outer = Span::begin("outer");
+            outer.arg("bytes", 3);
+            let mut inner = Span::begin("inner");
+            inner.arg("count", 1);
+            // Arguments go to their own span, not to the last one opened
+            outer.arg("trees", 2);
+        }
+        let trace = stop();
+        let names: Vec<&str> = trace.events.iter().map(|e| e.name.as_str()).collect();
+        assert_eq!(names, ["inner", "outer"]);
+        assert_eq!(
+            trace.events[0].args,
+            [("count", 1), ("scans", 0), ("scan_ns", 0)]
+        );
+        assert_eq!(
+            trace.events[1].args,
+            [("bytes", 3), ("trees", 2), ("scans", 0), ("scan_ns", 0)]
+        );
+        assert!(trace.events[0].start >= trace.events[1].start);
+        assert!(trace.to_json().contains("\"name\": \"outer\""));
+
+        // Nothing is recorded without a running trace
+        drop(Span::begin("ignored"));
+        assert!(stop().events.is_empty());
+    }
+}
@@ -0,0 +1,117 @@
+// Generates `tree-sitter-markdown-inline/src/unicode.h`, a two-level lookup table that classifies
+// unicode code points as whitespace or punctuation as defined by the markdown spec.
+//
+// https://github.github.com/gfm/#unicode-whitespace-character
+// https://github.github.com/gfm/#punctuation-character
+//
+// Run with `node common/generate-unicode-table.js`. The unicode version is the one of the node
+// version used to run this script.
+
+const fs = require('fs');
+const path = require('path');
+
+const OTHER = 0;
+const WHITESPACE = 1;
+const PUNCTUATION = 2;
+
+// Code points per block of the second level. Every code point takes 2 bits.
+const BLOCK_SIZE = 256;
+const BLOCK_BYTES = BLOCK_SIZE / 4;
+
+const whitespace = /^[\t\n\f\r\p{Zs}]$/u;
+const punctuation = /^[\p{Pc}\p{Pd}\p{Pe}\p{Pf}\p{Pi}\p{Po}\p{Ps}]$/u;
+
+function classify(code_point) {
+    if (code_point >= 0xd800 && code_point <= 0xdfff) {
+        return OTHER;
+    }
+    const c = String.fromCodePoint(code_point);
+    if (whitespace.test(c)) {
+        return WHITESPACE;
+    }
+    if (punctuation.test(c)) {
+        return PUNCTUATION;
+    }
+    return OTHER;
+}
+
+const blocks = [];
+const block_indices = new Map();
+const stage_1 = [];
+let limit = 0;
+for (let start = 0; start <= 0x10ffff; start += BLOCK_SIZE) {
+    const block = new Array(BLOCK_BYTES).fill(0);
+    let empty = true;
+    for (let i = 0; i < BLOCK_SIZE; i++) {
+        const c = classify(start + i);
+        if (c !== OTHER) {
+            empty = false;
+            block[i >> 2] |= c << ((i & 3) * 2);
+        }
+    }
+    if (!empty) {
+        limit = start + BLOCK_SIZE;
+    }
+    const key = block.join(',');
+    if (!block_indices.has(key)) {
+        block_indices.set(key, blocks.length);
+        blocks.push(block);
+    }
+    stage_1.push(block_indices.get(key));
+}
+stage_1.length = limit / BLOCK_SIZE;
+if (blocks.length > 256) {
+    throw new Error('Too many distinct blocks for 8 bit indices');
+}
+
+function hex(n) {
+    return '0x' + n.toString(16).padStart(2, '0');
+}
+
+function rows(values, per_row) {
+    let lines = [];
+    for (let i = 0; i < values.length; i += per_row) {
+        lines.push('        ' + values.slice(i, i + per_row).map(hex).join(', ') + ',');
+    }
+    return lines.join('\n');
+}
+
+const header = `// Generated by common/generate-unicode-table.js from unicode ${process.versions.unicode}. Do not edit.
+#ifndef TREE_SITTER_MARKDOWN_UNICODE_H_
+#define TREE_SITTER_MARKDOWN_UNICODE_H_
+
+#include <stdint.h>
+
+// Classes of unicode code points. See \`unicode_character_class\`.
+#define UNICODE_OTHER ${OTHER}
+#define UNICODE_WHITESPACE ${WHITESPACE}
+#define UNICODE_PUNCTUATION ${PUNCTUATION}
+
+// Code points at or above this are all \`UNICODE_OTHER\`.
+#define UNICODE_TABLE_LIMIT ${hex(limit)}
+
+// First level: index of the block in \`UNICODE_TABLE_BLOCKS\` for every ${BLOCK_SIZE} code points.
+static const uint8_t UNICODE_TABLE_INDEX[${stage_1.length}] = {
+${rows(stage_1, 16)}
+};
+
+// Second level: ${BLOCK_SIZE} code points per block, 2 bits per code point.
+static const uint8_t UNICODE_TABLE_BLOCKS[${blocks.length}][${BLOCK_BYTES}] = {
+${blocks.map(block => '    {\n' + rows(block, 16) + '\n    },').join('\n')}
+};
+
+// Returns \`UNICODE_WHITESPACE\` for unicode whitespace (Zs, tab, line feed, form feed and carriage
+// return), \`UNICODE_PUNCTUATION\` for unicode punctuation (Pc, Pd, Pe, Pf, Pi, Po and Ps) and
+// \`UNICODE_OTHER\` for anything else.
+static inline uint8_t unicode_character_class(int32_t c) {
+    if (c < 0 || c >= UNICODE_TABLE_LIMIT) {
+        return UNICODE_OTHER;
+    }
+    uint8_t block = UNICODE_TABLE_INDEX[c / ${BLOCK_SIZE}];
+    return (UNICODE_TABLE_BLOCKS[block][(c % ${BLOCK_SIZE}) / 4] >> ((c % 4) * 2)) & 0x3;
+}
+
+#endif // TREE_SITTER_MARKDOWN_UNICODE_H_
+`;
+
+fs.writeFileSync(path.join(__dirname, '../tree-sitter-markdown-inline/src/unicode.h'), header);
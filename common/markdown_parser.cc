@@ -0,0 +1,57 @@
+// The C functions of `common/markdown_parser.h`. Compile this with the scanners to use them.
+#include "markdown_parser.h"
+
+using TreeSitterMarkdown::MarkdownParser;
+using TreeSitterMarkdown::MarkdownTree;
+
+extern "C" {
+
+TSMarkdownParser *ts_markdown_parser_new(void) {
+    return reinterpret_cast<TSMarkdownParser *>(new MarkdownParser());
+}
+
+void ts_markdown_parser_delete(TSMarkdownParser *self) {
+    delete reinterpret_cast<MarkdownParser *>(self);
+}
+
+TSMarkdownTree *ts_markdown_parser_parse_string(
+    TSMarkdownParser *self,
+    const TSMarkdownTree *old_tree,
+    const char *string,
+    uint32_t length
+) {
+    const MarkdownTree *old = reinterpret_cast<const MarkdownTree *>(old_tree);
+    MarkdownTree *tree = reinterpret_cast<MarkdownParser *>(self)->parse(string, length, old);
+    return reinterpret_cast<TSMarkdownTree *>(tree);
+}
+
+TSMarkdownTree *ts_markdown_tree_copy(const TSMarkdownTree *self) {
+    return reinterpret_cast<TSMarkdownTree *>(reinterpret_cast<const MarkdownTree *>(self)->copy());
+}
+
+void ts_markdown_tree_delete(TSMarkdownTree *self) {
+    delete reinterpret_cast<MarkdownTree *>(self);
+}
+
+void ts_markdown_tree_edit(TSMarkdownTree *self, const TSInputEdit *edit) {
+    reinterpret_cast<MarkdownTree *>(self)->edit(*edit);
+}
+
+const TSTree *ts_markdown_tree_block_tree(const TSMarkdownTree *self) {
+    return reinterpret_cast<const MarkdownTree *>(self)->block_tree();
+}
+
+uint32_t ts_markdown_tree_inline_tree_count(const TSMarkdownTree *self) {
+    return reinterpret_cast<const MarkdownTree *>(self)->inline_trees().size();
+}
+
+const TSTree *ts_markdown_tree_inline_tree(const TSMarkdownTree *self, uint32_t index) {
+    const MarkdownTree *tree = reinterpret_cast<const MarkdownTree *>(self);
+    return index < tree->inline_trees().size() ? tree->inline_trees()[index] : nullptr;
+}
+
+const TSTree *ts_markdown_tree_inline_tree_for_node(const TSMarkdownTree *self, TSNode node) {
+    return reinterpret_cast<const MarkdownTree *>(self)->inline_tree(node);
+}
+
+}
@@ -0,0 +1,235 @@
+// Parsing of a whole markdown document with both grammars, for C and C++ programs that use
+// tree-sitter directly.
+//
+// A document is parsed with the block grammar first. Every `inline` node of the block tree is then
+// parsed with the inline grammar, with the children of the `inline` node excluded from the
+// included ranges, just like `MarkdownParser::parse` in bindings/rust/lib.rs does. The `inline`
+// nodes are found by walking the block tree with a cursor rather than with a query, and the
+// buffers for the nodes and ranges are kept in the parser between parses.
+//
+// C++ programs can use the classes in the `TreeSitterMarkdown` namespace below, which are defined
+// in this header. C programs use the `ts_markdown_` functions, which are defined in
+// `common/markdown_parser.cc`. Either way, link the parsers and scanners of both grammars and the
+// tree-sitter library.
+#ifndef TREE_SITTER_MARKDOWN_COMMON_MARKDOWN_PARSER_H_
+#define TREE_SITTER_MARKDOWN_COMMON_MARKDOWN_PARSER_H_
+
+#include <stdint.h>
+#include <tree_sitter/api.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+const TSLanguage *tree_sitter_markdown(void);
+const TSLanguage *tree_sitter_markdown_inline(void);
+
+typedef struct TSMarkdownParser TSMarkdownParser;
+// A block tree together with the inline trees of all of its `inline` nodes, in document order
+typedef struct TSMarkdownTree TSMarkdownTree;
+
+TSMarkdownParser *ts_markdown_parser_new(void);
+void ts_markdown_parser_delete(TSMarkdownParser *self);
+
+// Parses `length` bytes of UTF-8 at `string`. If `old_tree` is given, it must have been edited to
+// match `string` and is reused where possible. Returns null if a parse was cancelled, or if the
+// included ranges of an `inline` node could not be set.
+TSMarkdownTree *ts_markdown_parser_parse_string(
+    TSMarkdownParser *self,
+    const TSMarkdownTree *old_tree,
+    const char *string,
+    uint32_t length
+);
+
+// A copy that shares the nodes of `self`, so that it can be used on another thread while `self`
+// is edited
+TSMarkdownTree *ts_markdown_tree_copy(const TSMarkdownTree *self);
+void ts_markdown_tree_delete(TSMarkdownTree *self);
+// Applies `edit` to the block tree and all inline trees, before they are passed to
+// `ts_markdown_parser_parse_string` as the old tree
+void ts_markdown_tree_edit(TSMarkdownTree *self, const TSInputEdit *edit);
+const TSTree *ts_markdown_tree_block_tree(const TSMarkdownTree *self);
+uint32_t ts_markdown_tree_inline_tree_count(const TSMarkdownTree *self);
+const TSTree *ts_markdown_tree_inline_tree(const TSMarkdownTree *self, uint32_t index);
+// The inline tree of an `inline` node of the block tree, or null if there is none
+const TSTree *ts_markdown_tree_inline_tree_for_node(const TSMarkdownTree *self, TSNode node);
+
+#ifdef __cplusplus
+}
+
+#include <string.h>
+#include <unordered_map>
+#include <vector>
+
+namespace TreeSitterMarkdown {
+
+class MarkdownTree {
+public:
+    explicit MarkdownTree(TSTree *block_tree) : block_tree_(block_tree) {}
+
+    ~MarkdownTree() {
+        ts_tree_delete(block_tree_);
+        for (TSTree *tree : inline_trees_) {
+            ts_tree_delete(tree);
+        }
+    }
+
+    MarkdownTree(const MarkdownTree &) = delete;
+    MarkdownTree &operator=(const MarkdownTree &) = delete;
+
+    // See `ts_markdown_tree_copy`
+    MarkdownTree *copy() const {
+        MarkdownTree *result = new MarkdownTree(ts_tree_copy(block_tree_));
+        result->inline_trees_.reserve(inline_trees_.size());
+        for (TSTree *tree : inline_trees_) {
+            result->inline_trees_.push_back(ts_tree_copy(tree));
+        }
+        result->inline_indices_ = inline_indices_;
+        return result;
+    }
+
+    // See `ts_markdown_tree_edit`
+    void edit(const TSInputEdit &edit) {
+        ts_tree_edit(block_tree_, &edit);
+        for (TSTree *tree : inline_trees_) {
+            ts_tree_edit(tree, &edit);
+        }
+    }
+
+    const TSTree *block_tree() const { return block_tree_; }
+    const std::vector<TSTree *> &inline_trees() const { return inline_trees_; }
+
+    // See `ts_markdown_tree_inline_tree_for_node`
+    const TSTree *inline_tree(TSNode node) const {
+        auto index = inline_indices_.find(node.id);
+        return index == inline_indices_.end() ? nullptr : inline_trees_[index->second];
+    }
+
+private:
+    friend class MarkdownParser;
+
+    TSTree *block_tree_;
+    std::vector<TSTree *> inline_trees_;
+    std::unordered_map<const void *, size_t> inline_indices_;
+};
+
+class MarkdownParser {
+public:
+    MarkdownParser()
+        : parser_(ts_parser_new()),
+          block_language_(tree_sitter_markdown()),
+          inline_language_(tree_sitter_markdown_inline()),
+          inline_symbol_(ts_language_symbol_for_name(block_language_, "inline", strlen("inline"), true)) {}
+
+    ~MarkdownParser() { ts_parser_delete(parser_); }
+
+    MarkdownParser(const MarkdownParser &) = delete;
+    MarkdownParser &operator=(const MarkdownParser &) = delete;
+
+    // See `ts_markdown_parser_parse_string`
+    MarkdownTree *parse(const char *text, uint32_t length, const MarkdownTree *old_tree = nullptr) {
+        return parse(text, length, old_tree, [] {});
+    }
+
+    // Like `parse`, but calls `before_inline()` between the block pass and the inline passes,
+    // e.g. to change how the pages of a memory mapped `text` are read
+    template <typename F>
+    MarkdownTree *parse(const char *text, uint32_t length, const MarkdownTree *old_tree, F before_inline) {
+        ts_parser_set_included_ranges(parser_, nullptr, 0);
+        ts_parser_set_language(parser_, block_language_);
+        TSTree *block_tree = ts_parser_parse_string(
+            parser_, old_tree ? old_tree->block_tree_ : nullptr, text, length
+        );
+        if (!block_tree) {
+            return nullptr;
+        }
+        MarkdownTree *result = new MarkdownTree(block_tree);
+        find_inline_nodes(block_tree);
+        before_inline();
+
+        ts_parser_set_language(parser_, inline_language_);
+        result->inline_trees_.reserve(inline_nodes_.size());
+        result->inline_indices_.reserve(inline_nodes_.size());
+        for (TSNode node : inline_nodes_) {
+            if (!set_inline_ranges(node)) {
+                delete result;
+                return nullptr;
+            }
+            size_t index = result->inline_trees_.size();
+            const TSTree *old_inline_tree = old_tree && index < old_tree->inline_trees_.size()
+                ? old_tree->inline_trees_[index]
+                : nullptr;
+            TSTree *inline_tree = ts_parser_parse_string(parser_, old_inline_tree, text, length);
+            if (!inline_tree) {
+                delete result;
+                return nullptr;
+            }
+            result->inline_trees_.push_back(inline_tree);
+            result->inline_indices_.emplace(node.id, index);
+        }
+        return result;
+    }
+
+private:
+    // Collects the `inline` nodes in document order. They never contain each other, so the walk
+    // does not need to descend into them.
+    void find_inline_nodes(const TSTree *block_tree) {
+        inline_nodes_.clear();
+        TSTreeCursor cursor = ts_tree_cursor_new(ts_tree_root_node(block_tree));
+        for (;;) {
+            TSNode node = ts_tree_cursor_current_node(&cursor);
+            if (ts_node_symbol(node) == inline_symbol_) {
+                inline_nodes_.push_back(node);
+            } else if (ts_tree_cursor_goto_first_child(&cursor)) {
+                continue;
+            }
+            bool done = false;
+            while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+                if (!ts_tree_cursor_goto_parent(&cursor)) {
+                    done = true;
+                    break;
+                }
+            }
+            if (done) {
+                break;
+            }
+        }
+        ts_tree_cursor_delete(&cursor);
+    }
+
+    // Sets the included ranges of an `inline` node: its whole range without its children. Returns
+    // false if tree-sitter rejects them, in which case the previous ranges are still set.
+    bool set_inline_ranges(TSNode node) {
+        ranges_.clear();
+        TSRange range = {
+            ts_node_start_point(node), ts_node_end_point(node),
+            ts_node_start_byte(node), ts_node_end_byte(node),
+        };
+        uint32_t child_count = ts_node_named_child_count(node);
+        for (uint32_t i = 0; i < child_count; i++) {
+            TSNode child = ts_node_named_child(node, i);
+            ranges_.push_back({
+                range.start_point, ts_node_start_point(child),
+                range.start_byte, ts_node_start_byte(child),
+            });
+            range.start_point = ts_node_end_point(child);
+            range.start_byte = ts_node_end_byte(child);
+        }
+        ranges_.push_back(range);
+        return ts_parser_set_included_ranges(parser_, ranges_.data(), ranges_.size());
+    }
+
+    TSParser *parser_;
+    const TSLanguage *block_language_;
+    const TSLanguage *inline_language_;
+    TSSymbol inline_symbol_;
+    // Reused between parses, so that a parse does not allocate for each `inline` node
+    std::vector<TSRange> ranges_;
+    std::vector<TSNode> inline_nodes_;
+};
+
+}  // namespace TreeSitterMarkdown
+
+#endif
+
+#endif  // TREE_SITTER_MARKDOWN_COMMON_MARKDOWN_PARSER_H_
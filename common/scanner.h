@@ -0,0 +1,70 @@
+// Utilities shared by the external scanners of the block and the inline grammar.
+#ifndef TREE_SITTER_MARKDOWN_COMMON_SCANNER_H_
+#define TREE_SITTER_MARKDOWN_COMMON_SCANNER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace TreeSitterMarkdownCommon {
+
+// Bitflags for the entries of `CHARACTER_FLAGS`
+const uint8_t FLAG_WHITESPACE = 0x1 << 0;
+const uint8_t FLAG_PUNCTUATION = 0x1 << 1;
+
+#define W FLAG_WHITESPACE
+#define P FLAG_PUNCTUATION
+// Flags for every byte. Only ascii characters have any flags set, so this can also be used for
+// unicode code points below 256.
+constexpr uint8_t CHARACTER_FLAGS[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, W, W, 0, W, W, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    W, P, P, P, P, P, P, P, P, P, P, P, P, P, P, P,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, P, P, P, P, P, P,
+    P, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, P, P, P, P, P,
+    P, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, P, P, P, P, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+#undef W
+#undef P
+
+// Determines if a character is ascii punctuation as defined by the markdown spec.
+//
+// https://github.github.com/gfm/#ascii-punctuation-character
+inline bool is_punctuation(int32_t c) {
+    return c >= 0 && c < 256 && (CHARACTER_FLAGS[c] & FLAG_PUNCTUATION);
+}
+
+// Determines if a character is ascii whitespace as defined by the markdown spec.
+//
+// https://github.github.com/gfm/#whitespace-character
+inline bool is_whitespace(int32_t c) {
+    return c >= 0 && c < 256 && (CHARACTER_FLAGS[c] & FLAG_WHITESPACE);
+}
+
+// Tag names for html blocks of type 1 and 6.
+//
+// https://github.github.com/gfm/#html-blocks
+const size_t NUM_HTML_TAG_NAMES_RULE_1 = 3;
+const char *const HTML_TAG_NAMES_RULE_1[NUM_HTML_TAG_NAMES_RULE_1] = { "pre", "script", "style" };
+const size_t NUM_HTML_TAG_NAMES_RULE_7 = 62;
+const char *const HTML_TAG_NAMES_RULE_7[NUM_HTML_TAG_NAMES_RULE_7] = {
+    "address", "article", "aside", "base", "basefont", "blockquote", "body", "caption", "center",
+    "col", "colgroup", "dd", "details", "dialog", "dir", "div", "dl", "dt", "fieldset", "figcaption",
+    "figure", "footer", "form", "frame", "frameset", "h1", "h2", "h3", "h4", "h5", "h6", "head",
+    "header", "hr", "html", "iframe", "legend", "li", "link", "main", "menu", "menuitem", "nav",
+    "noframes", "ol", "optgroup", "option", "p", "param", "section", "source", "summary", "table",
+    "tbody", "td", "tfoot", "th", "thead", "title", "tr", "track", "ul"
+};
+
+}
+
+#endif // TREE_SITTER_MARKDOWN_COMMON_SCANNER_H_
@@ -0,0 +1,218 @@
+// Optional instrumentation of the external scanners.
+//
+// Only compiled into the scanners if `TREE_SITTER_MARKDOWN_STATS` is defined. Then every call to
+// `scan` is counted per token type, and the counters can be read through the functions declared
+// below. Counters are thread local and never merged, so they only describe the parses that ran on
+// the thread that reads them. Defining `TREE_SITTER_MARKDOWN_STATS_CYCLES` in addition also counts cpu cycles, on
+// platforms where a cycle counter can be read cheaply.
+//
+// Besides the totals, every scan requested by the parser records its lookahead: the number of
+// characters it advanced past the last call to `mark_end`. Tree-sitter has to re-lex a token
+// whenever an edit touches any of these characters, so tokens with a long lookahead make
+// incremental parsing expensive.
+//
+// A tracer can also be notified around every scan requested by the parser, to record the time of
+// individual scans, see `tree_sitter_markdown_scanner_trace`.
+#ifndef TREE_SITTER_MARKDOWN_COMMON_STATS_H_
+#define TREE_SITTER_MARKDOWN_COMMON_STATS_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Number of buckets of `TSMarkdownScannerStats.lookahead`
+#define TS_MARKDOWN_LOOKAHEAD_BUCKETS 16
+
+// Counters for one external token of a grammar.
+typedef struct {
+    // The name of the token in the `TokenType` enum of the scanner. The last entry, named
+    // "(none)", counts scans that did not produce a token.
+    const char *name;
+    // Scans in which this token was valid
+    uint64_t valid;
+    // Scans that produced this token
+    uint64_t emitted;
+    // How many of `emitted` were simulated by the scanner itself instead of requested by the parser
+    uint64_t simulated;
+    // Characters advanced during the scans in `emitted`. This includes characters looked at past
+    // the end of the token.
+    uint64_t advanced;
+    // Cpu cycles spent in the scans in `emitted`. Always 0 unless cycles are counted.
+    uint64_t cycles;
+    // The longest lookahead of the scans in `emitted` that were not simulated
+    uint64_t max_lookahead;
+    // Histogram of the lookahead of the scans in `emitted` that were not simulated. Bucket 0
+    // counts scans without lookahead, bucket `i` scans with a lookahead in `[2^(i-1), 2^i)` and
+    // the last bucket everything longer.
+    uint64_t lookahead[TS_MARKDOWN_LOOKAHEAD_BUCKETS];
+} TSMarkdownScannerStats;
+
+// Returns the counters of all scans on the calling thread since the last reset, one entry per
+// external token followed by the "(none)" entry. The number of entries is written to `count`.
+const TSMarkdownScannerStats *tree_sitter_markdown_scanner_stats(uint32_t *count);
+const TSMarkdownScannerStats *tree_sitter_markdown_inline_scanner_stats(uint32_t *count);
+
+// Sets all counters of the calling thread to 0.
+void tree_sitter_markdown_scanner_stats_reset(void);
+void tree_sitter_markdown_inline_scanner_stats_reset(void);
+
+// Callbacks around every scan requested by the parser. `scanner` is "block" or "inline", `token`
+// the name of the emitted token or "(none)".
+typedef struct {
+    void (*begin)(void *payload);
+    void (*end)(void *payload, const char *scanner, const char *token);
+    void *payload;
+} TSMarkdownScanTracer;
+
+// Sets the tracer of both scanners on the calling thread, or removes it if `tracer` is NULL.
+void tree_sitter_markdown_scanner_trace(const TSMarkdownScanTracer *tracer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#if defined(__cplusplus) && defined(TREE_SITTER_MARKDOWN_STATS)
+
+#include <tree_sitter/parser.h>
+#if defined(TREE_SITTER_MARKDOWN_STATS_CYCLES) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#endif
+
+namespace TreeSitterMarkdownStats {
+
+inline uint64_t read_cycles() {
+#if defined(TREE_SITTER_MARKDOWN_STATS_CYCLES) && (defined(__x86_64__) || defined(__i386__))
+    return __rdtsc();
+#elif defined(TREE_SITTER_MARKDOWN_STATS_CYCLES) && defined(__aarch64__)
+    uint64_t value;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(value));
+    return value;
+#else
+    return 0;
+#endif
+}
+
+// The lexer functions that are replaced while a scan is instrumented, and what they counted.
+struct LexerHook {
+    void (*advance)(TSLexer *, bool);
+    void (*mark_end)(TSLexer *);
+    // Characters advanced on this thread
+    uint64_t advanced;
+    // The value of `advanced` at the last call to `mark_end` in the current scan
+    uint64_t marked;
+    bool did_mark_end;
+};
+
+inline LexerHook &lexer_hook() {
+    static thread_local LexerHook hook = { nullptr, nullptr, 0, 0, false };
+    return hook;
+}
+
+inline TSMarkdownScanTracer &tracer() {
+    static thread_local TSMarkdownScanTracer tracer = { nullptr, nullptr, nullptr };
+    return tracer;
+}
+
+inline void count_advance(TSLexer *lexer, bool skip) {
+    LexerHook &hook = lexer_hook();
+    hook.advanced++;
+    hook.advance(lexer, skip);
+}
+
+inline void count_mark_end(TSLexer *lexer) {
+    LexerHook &hook = lexer_hook();
+    hook.marked = hook.advanced;
+    hook.did_mark_end = true;
+    hook.mark_end(lexer);
+}
+
+inline uint32_t lookahead_bucket(uint64_t lookahead) {
+    uint32_t bucket = 0;
+    while (lookahead > 0 && bucket < TS_MARKDOWN_LOOKAHEAD_BUCKETS - 1) {
+        lookahead >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+// Fills in the names of a table of counters and sets all counters to 0.
+inline void reset(TSMarkdownScannerStats *stats, const char *const *names, uint32_t num_tokens) {
+    for (uint32_t i = 0; i <= num_tokens; i++) {
+        stats[i] = TSMarkdownScannerStats();
+        stats[i].name = i < num_tokens ? names[i] : "(none)";
+    }
+}
+
+// Records one call to `scan` in a table of `num_tokens + 1` counters. Create it before the scan
+// and pass the result of the scan through `finish`.
+//
+// Characters and lookahead are counted by temporarily replacing `lexer->advance` and
+// `lexer->mark_end`. Nested probes, as used for scans that the block scanner simulates, leave the
+// replacement to the outermost probe, so characters advanced by a simulated scan are also
+// counted for the scan that started it. Only the outermost probe records lookahead and calls the
+// tracer.
+class ScanProbe {
+    TSMarkdownScannerStats *stats;
+    uint32_t num_tokens;
+    const char *scanner;
+    TSLexer *lexer;
+    bool simulated;
+    bool owns_hook;
+    uint64_t advanced_start;
+    uint64_t cycles_start;
+
+public:
+    ScanProbe(
+        TSMarkdownScannerStats *stats,
+        uint32_t num_tokens,
+        const char *scanner,
+        TSLexer *lexer,
+        const bool *valid_symbols,
+        bool simulated
+    ) : stats(stats), num_tokens(num_tokens), scanner(scanner), lexer(lexer), simulated(simulated) {
+        for (uint32_t i = 0; i < num_tokens; i++) {
+            if (valid_symbols[i]) stats[i].valid++;
+        }
+        LexerHook &hook = lexer_hook();
+        owns_hook = lexer->advance != count_advance;
+        if (owns_hook) {
+            hook.advance = lexer->advance;
+            hook.mark_end = lexer->mark_end;
+            hook.did_mark_end = false;
+            lexer->advance = count_advance;
+            lexer->mark_end = count_mark_end;
+            if (!simulated && tracer().begin) tracer().begin(tracer().payload);
+        }
+        advanced_start = hook.advanced;
+        cycles_start = read_cycles();
+    }
+
+    bool finish(bool result) {
+        uint64_t cycles = read_cycles() - cycles_start;
+        LexerHook &hook = lexer_hook();
+        TSMarkdownScannerStats &entry =
+            result && lexer->result_symbol < num_tokens ? stats[lexer->result_symbol] : stats[num_tokens];
+        entry.emitted++;
+        if (simulated) entry.simulated++;
+        entry.advanced += hook.advanced - advanced_start;
+        entry.cycles += cycles;
+        if (owns_hook) {
+            // Without a call to `mark_end` the token ends where the scan stopped
+            uint64_t lookahead = hook.did_mark_end ? hook.advanced - hook.marked : 0;
+            if (lookahead > entry.max_lookahead) entry.max_lookahead = lookahead;
+            if (!simulated) entry.lookahead[lookahead_bucket(lookahead)]++;
+            lexer->advance = hook.advance;
+            lexer->mark_end = hook.mark_end;
+            if (!simulated && tracer().end) tracer().end(tracer().payload, scanner, entry.name);
+        }
+        return result;
+    }
+};
+
+}
+
+#endif
+
+#endif
@@ -0,0 +1,123 @@
+// Tests of the C functions of common/markdown_parser.h. `make` in this directory builds and runs
+// them against the tree-sitter library at TREE_SITTER_DIR.
+#include "../markdown_parser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char TEXT[] = "# Title\n\nSome *emphasis* and `code`\n";
+
+static int failures = 0;
+
+#define CHECK(condition)                                                   \
+    do {                                                                   \
+        if (!(condition)) {                                                \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #condition); \
+            failures++;                                                    \
+        }                                                                  \
+    } while (0)
+
+// The first node of type `type` below `node` in document order, or a null node
+static TSNode find(TSNode node, const char *type, uint32_t skip) {
+    TSNode result = {{0}, 0, 0};
+    TSTreeCursor cursor = ts_tree_cursor_new(node);
+    for (;;) {
+        if (strcmp(ts_node_type(ts_tree_cursor_current_node(&cursor)), type) == 0) {
+            if (skip == 0) {
+                result = ts_tree_cursor_current_node(&cursor);
+                break;
+            }
+            skip--;
+        }
+        if (ts_tree_cursor_goto_first_child(&cursor)) {
+            continue;
+        }
+        while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+            if (!ts_tree_cursor_goto_parent(&cursor)) {
+                ts_tree_cursor_delete(&cursor);
+                return result;
+            }
+        }
+    }
+    ts_tree_cursor_delete(&cursor);
+    return result;
+}
+
+static int has_text(TSNode node, const char *text) {
+    uint32_t start = ts_node_start_byte(node);
+    uint32_t end = ts_node_end_byte(node);
+    return end - start == strlen(text) && memcmp(TEXT + start, text, end - start) == 0;
+}
+
+static void test_parse(TSMarkdownParser *parser) {
+    TSMarkdownTree *tree = ts_markdown_parser_parse_string(parser, NULL, TEXT, strlen(TEXT));
+    CHECK(tree != NULL);
+    if (!tree) {
+        return;
+    }
+    TSNode root = ts_tree_root_node(ts_markdown_tree_block_tree(tree));
+    CHECK(strcmp(ts_node_type(root), "document") == 0);
+    CHECK(ts_node_end_byte(root) == strlen(TEXT));
+    CHECK(ts_markdown_tree_inline_tree_count(tree) == 2);
+    CHECK(ts_markdown_tree_inline_tree(tree, 2) == NULL);
+
+    TSNode heading = find(root, "inline", 0);
+    TSNode paragraph = find(root, "inline", 1);
+    CHECK(!ts_node_is_null(paragraph));
+    CHECK(has_text(heading, "Title"));
+    CHECK(has_text(paragraph, "Some *emphasis* and `code`"));
+    CHECK(ts_markdown_tree_inline_tree_for_node(tree, heading) == ts_markdown_tree_inline_tree(tree, 0));
+    CHECK(ts_markdown_tree_inline_tree_for_node(tree, root) == NULL);
+
+    // Walk the inline tree of the paragraph
+    const TSTree *inline_tree = ts_markdown_tree_inline_tree_for_node(tree, paragraph);
+    CHECK(inline_tree == ts_markdown_tree_inline_tree(tree, 1));
+    TSNode inline_root = ts_tree_root_node(inline_tree);
+    CHECK(strcmp(ts_node_type(inline_root), "inline") == 0);
+    CHECK(!ts_node_has_error(inline_root));
+    TSNode emphasis = find(inline_root, "emphasis", 0);
+    CHECK(has_text(emphasis, "*emphasis*"));
+    CHECK(ts_node_named_child_count(emphasis) == 2);
+    CHECK(has_text(find(inline_root, "code_span", 0), "`code`"));
+    CHECK(ts_node_is_null(find(inline_root, "strong_emphasis", 0)));
+
+    TSMarkdownTree *copy = ts_markdown_tree_copy(tree);
+    CHECK(ts_markdown_tree_inline_tree_count(copy) == 2);
+    ts_markdown_tree_delete(tree);
+    CHECK(has_text(find(ts_tree_root_node(ts_markdown_tree_inline_tree(copy, 1)), "emphasis", 0), "*emphasis*"));
+    ts_markdown_tree_delete(copy);
+}
+
+static void test_reparse(TSMarkdownParser *parser) {
+    TSMarkdownTree *tree = ts_markdown_parser_parse_string(parser, NULL, TEXT, strlen(TEXT));
+    // Replace "Title" with "Other"
+    static const char EDITED[] = "# Other\n\nSome *emphasis* and `code`\n";
+    TSInputEdit edit = {2, 7, 7, {0, 2}, {0, 7}, {0, 7}};
+    ts_markdown_tree_edit(tree, &edit);
+    TSMarkdownTree *reparsed = ts_markdown_parser_parse_string(parser, tree, EDITED, strlen(EDITED));
+    TSMarkdownTree *fresh = ts_markdown_parser_parse_string(parser, NULL, EDITED, strlen(EDITED));
+    CHECK(ts_markdown_tree_inline_tree_count(reparsed) == ts_markdown_tree_inline_tree_count(fresh));
+    for (uint32_t i = 0; i < ts_markdown_tree_inline_tree_count(fresh); i++) {
+        char *expected = ts_node_string(ts_tree_root_node(ts_markdown_tree_inline_tree(fresh, i)));
+        char *actual = ts_node_string(ts_tree_root_node(ts_markdown_tree_inline_tree(reparsed, i)));
+        CHECK(strcmp(actual, expected) == 0);
+        free(expected);
+        free(actual);
+    }
+    ts_markdown_tree_delete(fresh);
+    ts_markdown_tree_delete(reparsed);
+    ts_markdown_tree_delete(tree);
+}
+
+int main(void) {
+    TSMarkdownParser *parser = ts_markdown_parser_new();
+    test_parse(parser);
+    test_reparse(parser);
+    ts_markdown_parser_delete(parser);
+    if (failures > 0) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("markdown_parser_test: all checks passed\n");
+    return 0;
+}
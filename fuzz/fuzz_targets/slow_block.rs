@@ -0,0 +1,13 @@
+//! Looks for inputs that make the block grammar slow, see `tree_sitter_md_fuzz`.
+#![no_main]
+
+use libfuzzer_sys::fuzz_target;
+use tree_sitter::Parser;
+
+fuzz_target!(|input: &[u8]| {
+    let mut parser = Parser::new();
+    parser.set_language(tree_sitter_md::language()).unwrap();
+    tree_sitter_md_fuzz::score("block", input, || {
+        parser.parse(input, None);
+    });
+});
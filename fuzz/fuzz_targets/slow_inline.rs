@@ -0,0 +1,18 @@
+//! Looks for inputs that make the inline grammar slow, see `tree_sitter_md_fuzz`.
+//!
+//! The whole input is parsed as the content of a single paragraph, so the fuzzer does not have
+//! to get through the block grammar first.
+#![no_main]
+
+use libfuzzer_sys::fuzz_target;
+use tree_sitter::Parser;
+
+fuzz_target!(|input: &[u8]| {
+    let mut parser = Parser::new();
+    parser
+        .set_language(tree_sitter_md::inline_language())
+        .unwrap();
+    tree_sitter_md_fuzz::score("inline", input, || {
+        parser.parse(input, None);
+    });
+});
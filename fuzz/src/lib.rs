@@ -0,0 +1,126 @@
+//! Shared code of the fuzz targets that look for slow inputs.
+//!
+//! Each input is parsed once and scored by the work done per input byte: either the characters
+//! the external scanners advanced (the default, which is deterministic) or the parse time, if
+//! `SLOW_INPUT_SCORE=time` is set. Two things happen with the score:
+//!
+//! * It is reported to libFuzzer as coverage, one edge per half power of two, so that inputs
+//!   reaching a higher bucket are kept in the corpus and mutated further. This turns the coverage
+//!   guided search into a search for slow inputs.
+//! * Whenever an input scores at least 10% higher than the best one seen so far in this process,
+//!   it is written to `benchmark/slow` (or `SLOW_INPUT_DIR`), where the benchmark can run it.
+
+use std::collections::hash_map::DefaultHasher;
+use std::hash::{Hash, Hasher};
+use std::path::PathBuf;
+use std::sync::Mutex;
+use std::time::Instant;
+
+use tree_sitter_md::stats;
+
+/// Inputs shorter than this are not written out. Their score per byte is dominated by the fixed
+/// cost of a parse.
+const MIN_LENGTH: usize = 32;
+/// How much an input has to beat the best one so far to be written out
+const IMPROVEMENT: f64 = 1.1;
+
+static BEST: Mutex<f64> = Mutex::new(0.0);
+
+/// Parses `input` with `parse` and scores it. `grammar` is used in the names of written inputs.
+pub fn score(grammar: &str, input: &[u8], parse: impl FnOnce()) {
+    stats::reset();
+    let start = Instant::now();
+    parse();
+    let elapsed = start.elapsed();
+    let bytes = input.len().max(1) as f64;
+    let score = if std::env::var_os("SLOW_INPUT_SCORE").map_or(false, |score| score == "time") {
+        elapsed.as_nanos() as f64 / bytes
+    } else {
+        let advanced: u64 = stats::block()
+            .iter()
+            .chain(stats::inline().iter())
+            .map(|token| token.advanced)
+            .sum();
+        advanced as f64 / bytes
+    };
+    cover(score);
+
+    if input.len() < MIN_LENGTH {
+        return;
+    }
+    let mut best = BEST.lock().unwrap();
+    if score >= *best * IMPROVEMENT && score > 0.0 {
+        *best = score;
+        write(grammar, input, score);
+    }
+}
+
+fn write(grammar: &str, input: &[u8], score: f64) {
+    let dir = std::env::var_os("SLOW_INPUT_DIR").map_or_else(
+        || PathBuf::from(concat!(env!("CARGO_MANIFEST_DIR"), "/../benchmark/slow")),
+        PathBuf::from,
+    );
+    let mut hasher = DefaultHasher::new();
+    input.hash(&mut hasher);
+    let path = dir.join(format!(
+        "{}-{:08.1}-{:016x}.md",
+        grammar,
+        score,
+        hasher.finish()
+    ));
+    if let Err(err) = std::fs::create_dir_all(&dir).and_then(|()| std::fs::write(&path, input)) {
+        eprintln!("Could not write {}: {}", path.display(), err);
+    }
+}
+
+/// Reports the bucket of `score`, in steps of half a power of two, to libFuzzer by calling a
+/// different function for each of them.
+///
+/// Branches on the bucket do not work: the optimizer folds a `match` whose arms only differ in a
+/// constant into a single call, which leaves one coverage counter for all buckets. A call through
+/// a table of functions can not be folded, and each function gets a counter of its own. The
+/// functions store different constants so that they are not merged either.
+fn cover(score: f64) {
+    let bucket = (score.max(1.0).log2() * 2.0) as usize;
+    BUCKETS[bucket.min(BUCKETS.len() - 1)]();
+}
+
+/// Written by the bucket functions, so that their bodies are not empty
+static mut BUCKET: u32 = 0;
+
+macro_rules! buckets {
+    ($($name:ident = $bucket:literal,)*) => {
+        $(
+            #[inline(never)]
+            fn $name() {
+                unsafe { std::ptr::write_volatile(std::ptr::addr_of_mut!(BUCKET), $bucket) };
+            }
+        )*
+
+        static BUCKETS: &[fn()] = &[$($name),*];
+    };
+}
+
+buckets! {
+    bucket_0 = 0,
+    bucket_1 = 1,
+    bucket_2 = 2,
+    bucket_3 = 3,
+    bucket_4 = 4,
+    bucket_5 = 5,
+    bucket_6 = 6,
+    bucket_7 = 7,
+    bucket_8 = 8,
+    bucket_9 = 9,
+    bucket_10 = 10,
+    bucket_11 = 11,
+    bucket_12 = 12,
+    bucket_13 = 13,
+    bucket_14 = 14,
+    bucket_15 = 15,
+    bucket_16 = 16,
+    bucket_17 = 17,
+    bucket_18 = 18,
+    bucket_19 = 19,
+    bucket_20 = 20,
+}
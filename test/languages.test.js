@@ -0,0 +1,34 @@
+const assert = require("node:assert");
+const test = require("node:test");
+const Parser = require("tree-sitter");
+const binding = require("..");
+
+test("the languages can be used with the tree-sitter package", () => {
+  const parser = new Parser();
+  assert.strictEqual(binding.markdown.name, "markdown");
+  parser.setLanguage(binding.markdown);
+  const block = parser.parse("# Title\n\nSome *emphasis*\n");
+  assert.strictEqual(block.rootNode.type, "document");
+  assert.ok(block.rootNode.descendantsOfType("inline").length === 2);
+
+  assert.strictEqual(binding.markdown_inline.name, "markdown_inline");
+  parser.setLanguage(binding.markdown_inline);
+  const inline = parser.parse("Some *emphasis*");
+  assert.strictEqual(inline.rootNode.type, "inline");
+  assert.strictEqual(inline.rootNode.descendantsOfType("emphasis")[0].text, "*emphasis*");
+});
+
+test("MarkdownParser parses with the runtime of the tree-sitter package", () => {
+  const text = "# Title\n\n* Some *emphasis*\n";
+  const parser = new Parser();
+  parser.setLanguage(binding.markdown);
+  const tree = new binding.MarkdownParser().parse(text);
+  assert.strictEqual(tree.toString(), parser.parse(text).rootNode.toString());
+});
+
+test("the languages are exported without loading the runtime", () => {
+  const exports = Object.getOwnPropertyDescriptors(binding);
+  assert.ok("value" in exports.markdown);
+  assert.ok("value" in exports.markdown_inline);
+  assert.ok("get" in exports.MarkdownParser);
+});
@@ -0,0 +1,56 @@
+const assert = require("node:assert");
+const test = require("node:test");
+const { MarkdownParser, MarkdownTree } = require("..");
+
+const TEXT = "# Title\n\nSome *emphasis*\n\n> quoted **strong**\n";
+
+function assertSameTree(actual, expected) {
+  assert.ok(actual instanceof MarkdownTree);
+  assert.strictEqual(actual.toString(), expected.toString());
+  assert.strictEqual(actual.inlineCount, expected.inlineCount);
+  for (let i = 0; i < expected.inlineCount; i++) {
+    assert.strictEqual(actual.inlineToString(i), expected.inlineToString(i));
+  }
+}
+
+test("parseAsync resolves to the same tree as parse", async () => {
+  const parser = new MarkdownParser();
+  const expected = parser.parse(TEXT);
+  assertSameTree(await parser.parseAsync(TEXT), expected);
+  assertSameTree(await parser.parseAsync(Buffer.from(TEXT)), expected);
+});
+
+test("parseAsync reuses an old tree that can be used again right away", async () => {
+  const parser = new MarkdownParser();
+  const tree = parser.parse(TEXT);
+  const start = TEXT.indexOf("Title");
+  const edited = TEXT.slice(0, start) + "Heading" + TEXT.slice(start + "Title".length);
+  tree.edit({
+    startIndex: start,
+    oldEndIndex: start + "Title".length,
+    newEndIndex: start + "Heading".length,
+    startPosition: { row: 0, column: start },
+    oldEndPosition: { row: 0, column: start + "Title".length },
+    newEndPosition: { row: 0, column: start + "Heading".length },
+  });
+  const pending = parser.parseAsync(edited, tree);
+  // The old tree was copied, so it can be parsed again while the first parse runs
+  const again = parser.parse(edited, tree);
+  assertSameTree(await pending, parser.parse(edited));
+  assertSameTree(again, parser.parse(edited));
+});
+
+test("parseAsync runs parses concurrently without mixing up their results", async () => {
+  const parser = new MarkdownParser();
+  const texts = Array.from({ length: 16 }, (_, i) => `# ${i}\n\n${"*a* ".repeat(i + 1)}\n`);
+  const trees = await Promise.all(texts.map((text) => parser.parseAsync(text)));
+  trees.forEach((tree, i) => {
+    assertSameTree(tree, parser.parse(texts[i]));
+    assert.strictEqual((tree.inlineToString(1).match(/\(emphasis /g) || []).length, i + 1);
+  });
+});
+
+test("parseAsync throws for invalid arguments", () => {
+  const parser = new MarkdownParser();
+  assert.throws(() => parser.parseAsync(42), TypeError);
+});
@@ -0,0 +1,90 @@
+const assert = require("node:assert");
+const fs = require("node:fs");
+const os = require("node:os");
+const path = require("node:path");
+const test = require("node:test");
+const { MarkdownParser, parseBatch } = require("..");
+
+const TEXTS = [
+  "# Title\n\nSome *emphasis*\n",
+  "",
+  "* a\n* b\n\n  > quoted `code`\n",
+  "| a | b |\n|---|---|\n| *c* | d |\n",
+  "```js\nlet a;\n```\n\n[link](https://example.com) ~~gone~~\n",
+];
+
+// What `parseBatch` should report for `text`, computed from `parse`. The flat tree has no
+// separate node for the root of each inline tree.
+function expectedResult(parser, text) {
+  const tree = parser.parse(text);
+  const flat = tree.toArrays();
+  let sexps = tree.toString();
+  for (let i = 0; i < tree.inlineCount; i++) {
+    sexps += tree.inlineToString(i);
+  }
+  return {
+    bytes: Buffer.byteLength(text),
+    nodeCount: flat.types.length + tree.inlineCount,
+    inlineCount: tree.inlineCount,
+    hasErrors: /\b(ERROR|MISSING)\b/.test(sexps),
+    flat,
+  };
+}
+
+function assertSameFlatTree(actual, expected) {
+  for (const key of ["types", "startIndex", "endIndex", "parent", "firstChild", "nextSibling"]) {
+    assert.deepStrictEqual(Array.from(actual[key]), Array.from(expected[key]), key);
+  }
+}
+
+test("parseBatch results match parse", async () => {
+  const parser = new MarkdownParser();
+  const results = await parseBatch(TEXTS.map((text) => Buffer.from(text)), { flat: true });
+  assert.strictEqual(results.length, TEXTS.length);
+  results.forEach((result, i) => {
+    const expected = expectedResult(parser, TEXTS[i]);
+    assert.strictEqual(result.error, undefined);
+    assert.strictEqual(result.bytes, expected.bytes);
+    assert.strictEqual(result.nodeCount, expected.nodeCount);
+    assert.strictEqual(result.inlineCount, expected.inlineCount);
+    assert.strictEqual(result.errors !== undefined, expected.hasErrors);
+    assertSameFlatTree(result.tree, expected.flat);
+  });
+});
+
+test("parseBatch gives the same results for any number of threads", async () => {
+  const inputs = [];
+  for (let i = 0; i < 50; i++) {
+    inputs.push(Buffer.from(TEXTS[i % TEXTS.length] + "*x* ".repeat(i)));
+  }
+  const single = await parseBatch(inputs, { threads: 1 });
+  for (const threads of [0, 4, 1000]) {
+    assert.deepStrictEqual(await parseBatch(inputs, { threads }), single);
+  }
+  assert.ok(single.every((result) => result.tree === undefined));
+});
+
+test("parseBatch parses files and reports the ones it can not read", async () => {
+  const dir = fs.mkdtempSync(path.join(os.tmpdir(), "tree-sitter-markdown-"));
+  try {
+    const file = path.join(dir, "document.md");
+    fs.writeFileSync(file, TEXTS[0]);
+    const [fromFile, missing, fromBuffer] = await parseBatch([
+      file,
+      path.join(dir, "missing.md"),
+      Buffer.from(TEXTS[0]),
+    ]);
+    assert.deepStrictEqual(fromFile, fromBuffer);
+    assert.strictEqual(typeof missing.error, "string");
+    assert.match(missing.error, /missing\.md/);
+    assert.strictEqual(missing.bytes, undefined);
+  } finally {
+    fs.rmSync(dir, { recursive: true, force: true });
+  }
+});
+
+test("parseBatch rejects invalid arguments", () => {
+  assert.throws(() => parseBatch("not an array"), TypeError);
+  assert.throws(() => parseBatch([42]), TypeError);
+  assert.throws(() => parseBatch([], { threads: "many" }), TypeError);
+});
@@ -0,0 +1,76 @@
+const assert = require("node:assert");
+const fs = require("node:fs");
+const os = require("node:os");
+const path = require("node:path");
+const test = require("node:test");
+const { MarkdownParser, MarkdownTree } = require("..");
+
+const TEXT = "# Title\n\nSome *emphasis* and `code`\n";
+
+function withFile(contents, callback) {
+  const dir = fs.mkdtempSync(path.join(os.tmpdir(), "tree-sitter-markdown-"));
+  try {
+    const file = path.join(dir, "document.md");
+    fs.writeFileSync(file, contents);
+    callback(file, dir);
+  } finally {
+    fs.rmSync(dir, { recursive: true, force: true });
+  }
+}
+
+function assertSameTrees(actual, expected) {
+  assert.strictEqual(actual.toString(), expected.toString());
+  assert.strictEqual(actual.inlineCount, expected.inlineCount);
+  for (let i = 0; i < actual.inlineCount; i++) {
+    assert.strictEqual(actual.inlineToString(i), expected.inlineToString(i));
+    assert.deepStrictEqual(actual.inlineRange(i), expected.inlineRange(i));
+  }
+}
+
+test("parseFile parses a file like parse parses its contents", () => {
+  const parser = new MarkdownParser();
+  for (const text of [TEXT, "", "* a\n* b\n\n  > quoted **strong** ünïcödé\n"]) {
+    withFile(text, (file) => {
+      const tree = parser.parseFile(file);
+      assert.ok(tree instanceof MarkdownTree);
+      assertSameTrees(tree, parser.parse(text));
+    });
+  }
+});
+
+test("parseFile reuses an old tree", () => {
+  const parser = new MarkdownParser();
+  const start = TEXT.indexOf("*emphasis*");
+  const edited = TEXT.slice(0, start) + "**strong**" + TEXT.slice(start + "*emphasis*".length);
+  const tree = parser.parse(TEXT);
+  tree.edit({
+    startIndex: start,
+    oldEndIndex: start + "*emphasis*".length,
+    newEndIndex: start + "**strong**".length,
+    startPosition: { row: 2, column: start - TEXT.indexOf("Some") },
+    oldEndPosition: { row: 2, column: start - TEXT.indexOf("Some") + "*emphasis*".length },
+    newEndPosition: { row: 2, column: start - TEXT.indexOf("Some") + "**strong**".length },
+  });
+  withFile(edited, (file) => {
+    const reparsed = parser.parseFile(file, tree);
+    assertSameTrees(reparsed, parser.parse(edited));
+    assert.match(reparsed.inlineToString(1), /strong_emphasis/);
+  });
+});
+
+test("parseFile reads files that report a size of 0", { skip: process.platform !== "linux" }, () => {
+  const parser = new MarkdownParser();
+  const file = "/proc/version";
+  const text = fs.readFileSync(file, "utf8");
+  assert.ok(text.length > 0);
+  assertSameTrees(parser.parseFile(file), parser.parse(text));
+});
+
+test("parseFile throws for files it can not read", () => {
+  const parser = new MarkdownParser();
+  withFile(TEXT, (file, dir) => {
+    assert.throws(() => parser.parseFile(path.join(dir, "missing.md")), /missing\.md/);
+    assert.throws(() => parser.parseFile(42), TypeError);
+    assert.throws(() => parser.parseFile(file, {}), TypeError);
+  });
+});
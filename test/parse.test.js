@@ -0,0 +1,65 @@
+const assert = require("node:assert");
+const test = require("node:test");
+const { MarkdownParser, MarkdownTree } = require("..");
+
+const TEXT = "# Title\n\nSome *emphasis* and `code`\n";
+
+test("parse returns the block tree and one inline tree per inline node", () => {
+  const tree = new MarkdownParser().parse(TEXT);
+  assert.ok(tree instanceof MarkdownTree);
+  assert.match(tree.toString(), /^\(document /);
+  assert.match(tree.toString(), /atx_heading/);
+  assert.strictEqual(tree.inlineCount, (tree.toString().match(/\(inline\b/g) || []).length);
+  assert.strictEqual(tree.inlineCount, 2);
+});
+
+test("inline trees cover the inline content of the document", () => {
+  const tree = new MarkdownParser().parse(TEXT);
+  const bytes = Buffer.from(TEXT);
+  const paragraph = tree.inlineRange(1);
+  assert.strictEqual(bytes.toString("utf8", paragraph.startIndex, paragraph.endIndex), "Some *emphasis* and `code`");
+  assert.strictEqual(paragraph.startPosition.row, 2);
+  assert.match(tree.inlineToString(1), /^\(inline \(emphasis .*\(code_span /);
+  assert.throws(() => tree.inlineToString(2), RangeError);
+});
+
+test("buffers are parsed like strings", () => {
+  const parser = new MarkdownParser();
+  const fromString = parser.parse(TEXT);
+  const fromBuffer = parser.parse(Buffer.from(TEXT));
+  const fromArray = parser.parse(new TextEncoder().encode(TEXT));
+  for (const tree of [fromBuffer, fromArray]) {
+    assert.strictEqual(tree.toString(), fromString.toString());
+    assert.strictEqual(tree.inlineCount, fromString.inlineCount);
+    for (let i = 0; i < tree.inlineCount; i++) {
+      assert.strictEqual(tree.inlineToString(i), fromString.inlineToString(i));
+    }
+  }
+});
+
+test("an edited tree is parsed again to the same result as a new parse", () => {
+  const parser = new MarkdownParser();
+  const tree = parser.parse(TEXT);
+  const start = TEXT.indexOf("*emphasis*");
+  const edited = TEXT.slice(0, start) + "**strong**" + TEXT.slice(start + "*emphasis*".length);
+  tree.edit({
+    startIndex: start,
+    oldEndIndex: start + "*emphasis*".length,
+    newEndIndex: start + "**strong**".length,
+    startPosition: { row: 2, column: start - TEXT.indexOf("Some") },
+    oldEndPosition: { row: 2, column: start - TEXT.indexOf("Some") + "*emphasis*".length },
+    newEndPosition: { row: 2, column: start - TEXT.indexOf("Some") + "**strong**".length },
+  });
+  const reparsed = parser.parse(edited, tree);
+  const fresh = parser.parse(edited);
+  assert.strictEqual(reparsed.toString(), fresh.toString());
+  assert.strictEqual(reparsed.inlineToString(1), fresh.inlineToString(1));
+  assert.match(reparsed.inlineToString(1), /strong_emphasis/);
+});
+
+test("invalid arguments throw", () => {
+  const parser = new MarkdownParser();
+  assert.throws(() => parser.parse(42), TypeError);
+  assert.throws(() => parser.parse(TEXT, {}), TypeError);
+  assert.throws(() => new MarkdownTree(), TypeError);
+});
@@ -0,0 +1,47 @@
+const assert = require("node:assert");
+const test = require("node:test");
+const { MarkdownParser, scannerStats, resetScannerStats } = require("..");
+
+const TEXT = "# Title\n\nSome *emphasis* and `code`\n";
+
+// Only exported by builds with TREE_SITTER_MARKDOWN_STATS set, see binding.gyp
+const skip = scannerStats === undefined && "the addon was built without TREE_SITTER_MARKDOWN_STATS";
+
+function token(stats, name) {
+  const result = stats.find((entry) => entry.name === name);
+  assert.ok(result, `no counters for ${name}`);
+  return result;
+}
+
+test("scannerStats counts the scans of parse", { skip }, () => {
+  resetScannerStats();
+  const empty = scannerStats();
+  for (const entry of [...empty.block, ...empty.inline]) {
+    assert.strictEqual(entry.valid, 0);
+    assert.strictEqual(entry.emitted, 0);
+    assert.strictEqual(entry.advanced, 0);
+    assert.strictEqual(entry.lookahead.length, 16);
+  }
+  assert.strictEqual(empty.block[empty.block.length - 1].name, "(none)");
+  assert.strictEqual(empty.inline[empty.inline.length - 1].name, "(none)");
+
+  new MarkdownParser().parse(TEXT);
+  const stats = scannerStats();
+  const open = token(stats.inline, "EMPHASIS_OPEN_STAR");
+  assert.ok(open.emitted >= 1);
+  assert.ok(open.valid >= open.emitted);
+  assert.ok(open.advanced > 0);
+  const close = token(stats.inline, "EMPHASIS_CLOSE_STAR");
+  assert.ok(close.emitted >= 1);
+  assert.ok(token(stats.block, "ATX_H1_MARKER").emitted >= 1);
+
+  resetScannerStats();
+  assert.deepStrictEqual(scannerStats(), empty);
+});
+
+test("scannerStats does not count parses on other threads", { skip }, async () => {
+  resetScannerStats();
+  const before = scannerStats();
+  await new MarkdownParser().parseAsync(TEXT);
+  assert.deepStrictEqual(scannerStats(), before);
+});
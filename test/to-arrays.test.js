@@ -0,0 +1,96 @@
+const assert = require("node:assert");
+const test = require("node:test");
+const { MarkdownParser, nodeTypes } = require("..");
+
+const TEXT = "# Title *one*\n\nSome *emphasis* and `code`\n\n* item **strong**\n* [link](url)\n";
+
+// The flat tree has the symbols of the block grammar first, then those of the inline grammar.
+// Symbol 0 of both is "end".
+const INLINE_OFFSET = nodeTypes.names.indexOf("end", 1);
+
+// The S-expression of the named nodes below `node`, in the format of `toString`, but only with the
+// children for which `include` returns true
+function sexp(flat, node, include) {
+  let result = "(" + nodeTypes.names[flat.types[node]];
+  for (let child = flat.firstChild[node]; child !== -1; child = flat.nextSibling[child]) {
+    if (nodeTypes.named[flat.types[child]] && include(child)) {
+      result += " " + sexp(flat, child, include);
+    }
+  }
+  return result + ")";
+}
+
+// `toString` and `inlineToString` print field names, which the flat tree does not have
+function withoutFields(string) {
+  return string.replace(/\w+: /g, "");
+}
+
+test("the flat tree round-trips the types of the block and inline trees", () => {
+  const tree = new MarkdownParser().parse(TEXT);
+  const flat = tree.toArrays();
+  assert.ok(INLINE_OFFSET > 0);
+  const isBlock = (node) => flat.types[node] < INLINE_OFFSET;
+  assert.strictEqual(sexp(flat, 0, isBlock), withoutFields(tree.toString()));
+
+  const inlineNodes = [];
+  for (let node = 0; node < flat.types.length; node++) {
+    if (isBlock(node) && nodeTypes.names[flat.types[node]] === "inline") {
+      inlineNodes.push(node);
+    }
+  }
+  assert.strictEqual(inlineNodes.length, tree.inlineCount);
+  inlineNodes.forEach((node, i) => {
+    assert.strictEqual(sexp(flat, node, (child) => !isBlock(child)), withoutFields(tree.inlineToString(i)));
+  });
+});
+
+test("the flat tree has the ranges and links of the nodes", () => {
+  const tree = new MarkdownParser().parse(TEXT);
+  const flat = tree.toArrays();
+  const bytes = Buffer.from(TEXT);
+  const count = flat.types.length;
+  for (const key of ["startIndex", "endIndex", "parent", "firstChild", "nextSibling"]) {
+    assert.strictEqual(flat[key].length, count);
+  }
+  assert.strictEqual(nodeTypes.names[flat.types[0]], "document");
+  assert.strictEqual(flat.startIndex[0], 0);
+  assert.strictEqual(flat.endIndex[0], bytes.length);
+  assert.strictEqual(flat.parent[0], -1);
+  assert.strictEqual(flat.nextSibling[0], -1);
+
+  // Pre-order: every node comes after its parent, children are sorted and inside their parent
+  for (let node = 1; node < count; node++) {
+    const parent = flat.parent[node];
+    assert.ok(parent >= 0 && parent < node);
+    assert.ok(flat.startIndex[node] >= flat.startIndex[parent]);
+    assert.ok(flat.endIndex[node] <= flat.endIndex[parent]);
+    const next = flat.nextSibling[node];
+    if (next !== -1) {
+      assert.strictEqual(flat.parent[next], parent);
+      assert.ok(flat.startIndex[next] >= flat.endIndex[node]);
+    }
+  }
+  for (let node = 0; node < count; node++) {
+    const child = flat.firstChild[node];
+    if (child !== -1) {
+      assert.strictEqual(child, node + 1);
+      assert.strictEqual(flat.parent[child], node);
+    }
+  }
+
+  const text = (type) => {
+    const node = flat.types.findIndex((t) => nodeTypes.names[t] === type);
+    return bytes.toString("utf8", flat.startIndex[node], flat.endIndex[node]);
+  };
+  assert.strictEqual(text("emphasis"), "*one*");
+  assert.strictEqual(text("strong_emphasis"), "**strong**");
+  assert.strictEqual(text("code_span"), "`code`");
+  assert.strictEqual(text("inline_link"), "[link](url)");
+});
+
+test("nodeTypes describes every type in the flat tree", () => {
+  assert.strictEqual(nodeTypes.names.length, nodeTypes.named.length);
+  assert.strictEqual(nodeTypes.names[nodeTypes.names.length - 1], "ERROR");
+  const flat = new MarkdownParser().parse(TEXT).toArrays();
+  assert.ok(flat.types.every((type) => type < nodeTypes.names.length));
+});
@@ -1,4 +1,7 @@
 #include <tree_sitter/parser.h>
+#include "unicode.h"
+#include "../../common/scanner.h"
+#include "../../common/stats.h"
 #include <cassert>
 #include <vector>
 #include <cstring>
@@ -25,19 +28,38 @@ namespace TreeSitterMarkdownInline {
         STRIKETHROUGH_CLOSE,
     };
 
-    // Determines if a character is punctuation as defined by the markdown spec.
-    bool is_punctuation(char c) {
-        return
-            (c >= '!' && c <= '/') ||
-            (c >= ':' && c <= '@') ||
-            (c >= '[' && c <= '`') ||
-            (c >= '{' && c <= '~');
-    }
+#ifdef TREE_SITTER_MARKDOWN_STATS
+    // Names of the tokens in the order of `TokenType`
+    const char *const TOKEN_NAMES[] = {
+        "ERROR",
+        "TRIGGER_ERROR",
+        "CODE_SPAN_START",
+        "CODE_SPAN_CLOSE",
+        "EMPHASIS_OPEN_STAR",
+        "EMPHASIS_OPEN_UNDERSCORE",
+        "EMPHASIS_CLOSE_STAR",
+        "EMPHASIS_CLOSE_UNDERSCORE",
+        "LAST_TOKEN_WHITESPACE",
+        "LAST_TOKEN_PUNCTUATION",
+        "STRIKETHROUGH_OPEN",
+        "STRIKETHROUGH_CLOSE",
+    };
+    const uint32_t NUM_TOKENS = sizeof(TOKEN_NAMES) / sizeof(TOKEN_NAMES[0]);
+    static_assert(NUM_TOKENS == STRIKETHROUGH_CLOSE + 1, "Every token needs a name");
 
-    // Determines if a character is ascii whitespace as defined by the markdown spec.
-    bool is_whitespace(char c) {
-        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    // Counters of the calling thread, with an extra entry for scans without a result
+    TSMarkdownScannerStats *scanner_stats() {
+        static thread_local TSMarkdownScannerStats stats[NUM_TOKENS + 1] = {};
+        if (stats[0].name == nullptr) {
+            TreeSitterMarkdownStats::reset(stats, TOKEN_NAMES, NUM_TOKENS);
+        }
+        return stats;
     }
+#endif
+
+    using TreeSitterMarkdownCommon::CHARACTER_FLAGS;
+    using TreeSitterMarkdownCommon::FLAG_WHITESPACE;
+    using TreeSitterMarkdownCommon::FLAG_PUNCTUATION;
 
     // State bitflags used with `Scanner.state`
 
@@ -45,6 +67,103 @@ namespace TreeSitterMarkdownInline {
     const uint8_t STATE_EMPHASIS_DELIMITER_MOD_3 = 0x3;
     // Current delimiter run is opening
     const uint8_t STATE_EMPHASIS_DELIMITER_IS_OPEN = 0x1 << 2;
+    // The `CharacterClass` of the character after the current delimiter run
+    const uint8_t STATE_EMPHASIS_DELIMITER_AFTER_SHIFT = 3;
+    const uint8_t STATE_EMPHASIS_DELIMITER_AFTER = 0x3 << STATE_EMPHASIS_DELIMITER_AFTER_SHIFT;
+    // Current delimiter run is too long to be used as delimiters and is text, see
+    // `Scanner::parse_text_run`
+    const uint8_t STATE_DELIMITER_RUN_IS_TEXT = 0x1 << 5;
+
+    // The longest delimiter run that is looked at again for every delimiter in it. Backtick runs
+    // that are longer never open a code span that can be closed, as their length does not fit into
+    // `Scanner.code_span_delimiter_length`. Longer runs of '*', '_' and '~' are counted to the end
+    // once, and are text if they can neither open nor close, see `Scanner::parse_delimiter_run`.
+    const size_t MAX_DELIMITER_RUN_LENGTH = UINT8_MAX;
+
+    // Classes of the characters surrounding a delimiter run. The beginning and end of a line count
+    // as whitespace. The values match the ones of `unicode_character_class`.
+    enum CharacterClass : uint8_t {
+        CHARACTER_OTHER = UNICODE_OTHER,
+        CHARACTER_WHITESPACE = UNICODE_WHITESPACE,
+        CHARACTER_PUNCTUATION = UNICODE_PUNCTUATION,
+    };
+
+    // Classifies a character as unicode whitespace, punctuation or other. For ascii characters
+    // punctuation also includes symbols like '$' or '+', as defined by the markdown spec.
+    CharacterClass character_class(int32_t c) {
+        if (c >= 0 && c < 0x80) {
+            uint8_t flags = CHARACTER_FLAGS[c];
+            return
+                (flags & FLAG_WHITESPACE) ? CHARACTER_WHITESPACE :
+                (flags & FLAG_PUNCTUATION) ? CHARACTER_PUNCTUATION :
+                CHARACTER_OTHER;
+        }
+        return CharacterClass(unicode_character_class(c));
+    }
+
+    // The class of the character before the current token. The grammar emits the tokens in
+    // `valid_symbols` that tell this only after ascii whitespace and punctuation. Unicode
+    // whitespace and punctuation are part of a `$._word_no_digit` token, so there the class is
+    // other, see `Scanner::parse_word`.
+    CharacterClass last_token_class(const bool *valid_symbols) {
+        return
+            valid_symbols[LAST_TOKEN_WHITESPACE] ? CHARACTER_WHITESPACE :
+            valid_symbols[LAST_TOKEN_PUNCTUATION] ? CHARACTER_PUNCTUATION :
+            CHARACTER_OTHER;
+    }
+
+    // Whether a character is part of a `$._word_no_digit` token of the grammar.
+    bool is_word_character(int32_t c) {
+        return !(c == ' ' || c == '\t' || c == '\n' || c == '\r' || (c >= '0' && c <= '9') ||
+            TreeSitterMarkdownCommon::is_punctuation(c));
+    }
+
+    // Bitflags for the entries of `Delimiter.rules`
+    const uint8_t DELIMITER_CAN_OPEN = 0x1 << 0;
+    const uint8_t DELIMITER_CAN_CLOSE = 0x1 << 1;
+
+    // Whether a run of '*' or '~' can open or close, indexed by the class of the character before
+    // and the class of the character after the run. This is exactly whether the run is left- or
+    // right-flanking. The tables are there so that the rules can be checked against the spec at a
+    // glance, they are not faster than spelling the conditions out.
+    //
+    // https://github.github.com/gfm/#left-flanking-delimiter-run
+    const uint8_t DELIMITER_RULES_STAR[3][3] = {
+        // before: other
+        { DELIMITER_CAN_OPEN | DELIMITER_CAN_CLOSE, DELIMITER_CAN_CLOSE, DELIMITER_CAN_CLOSE },
+        // before: whitespace
+        { DELIMITER_CAN_OPEN, 0, DELIMITER_CAN_OPEN },
+        // before: punctuation
+        { DELIMITER_CAN_OPEN, DELIMITER_CAN_CLOSE, DELIMITER_CAN_OPEN | DELIMITER_CAN_CLOSE },
+    };
+
+    // The same for '_', which can not open or close emphasis inside of a word.
+    //
+    // https://github.github.com/gfm/#can-open-emphasis
+    const uint8_t DELIMITER_RULES_UNDERSCORE[3][3] = {
+        // before: other
+        { 0, DELIMITER_CAN_CLOSE, DELIMITER_CAN_CLOSE },
+        // before: whitespace
+        { DELIMITER_CAN_OPEN, 0, DELIMITER_CAN_OPEN },
+        // before: punctuation
+        { DELIMITER_CAN_OPEN, DELIMITER_CAN_CLOSE, DELIMITER_CAN_OPEN | DELIMITER_CAN_CLOSE },
+    };
+
+    // Description of a character that forms delimiter runs. See `Scanner::parse_delimiter_run`.
+    struct Delimiter {
+        char character;
+        TokenType open;
+        TokenType close;
+        const uint8_t (*rules)[3];
+        // By default only the first two delimiters of an opening run are emitted as opening
+        // delimiters right away, after that the rest of the run is looked at again. If this is
+        // set, all delimiters of the run are opening as long as that is valid.
+        bool keep_open;
+    };
+
+    const Delimiter DELIMITER_STAR = { '*', EMPHASIS_OPEN_STAR, EMPHASIS_CLOSE_STAR, DELIMITER_RULES_STAR, false };
+    const Delimiter DELIMITER_UNDERSCORE = { '_', EMPHASIS_OPEN_UNDERSCORE, EMPHASIS_CLOSE_UNDERSCORE, DELIMITER_RULES_UNDERSCORE, true };
+    const Delimiter DELIMITER_TILDE = { '~', STRIKETHROUGH_OPEN, STRIKETHROUGH_CLOSE, DELIMITER_RULES_STAR, false };
 
     struct Scanner {
 
@@ -52,7 +171,7 @@ namespace TreeSitterMarkdownInline {
         uint8_t state;
         uint8_t code_span_delimiter_length;
         // The number of characters remaining in the currrent emphasis delimiter run.
-        uint8_t num_emphasis_delimiters_left;
+        uint32_t num_emphasis_delimiters_left;
 
         Scanner() {
             deserialize(NULL, 0);
@@ -63,7 +182,8 @@ namespace TreeSitterMarkdownInline {
             size_t i = 0;
             buffer[i++] = state;
             buffer[i++] = code_span_delimiter_length;
-            buffer[i++] = num_emphasis_delimiters_left;
+            memcpy(&buffer[i], &num_emphasis_delimiters_left, sizeof(num_emphasis_delimiters_left));
+            i += sizeof(num_emphasis_delimiters_left);
             return i;
         }
 
@@ -77,7 +197,8 @@ namespace TreeSitterMarkdownInline {
                 size_t i = 0;
                 state = buffer[i++];
                 code_span_delimiter_length = buffer[i++];
-                num_emphasis_delimiters_left = buffer[i++];
+                memcpy(&num_emphasis_delimiters_left, &buffer[i], sizeof(num_emphasis_delimiters_left));
+                i += sizeof(num_emphasis_delimiters_left);
             }
         }
 
@@ -96,12 +217,33 @@ namespace TreeSitterMarkdownInline {
         }
 
         bool scan(TSLexer *lexer, const bool *valid_symbols) {
+#ifdef TREE_SITTER_MARKDOWN_STATS
+            TreeSitterMarkdownStats::ScanProbe probe(scanner_stats(), NUM_TOKENS, "inline", lexer, valid_symbols, false);
+            return probe.finish(scan_token(lexer, valid_symbols));
+#else
+            return scan_token(lexer, valid_symbols);
+#endif
+        }
+
+        bool scan_token(TSLexer *lexer, const bool *valid_symbols) {
             // A normal tree-sitter rule decided that the current branch is invalid and now "requests"
             // an error to stop the branch
             if (valid_symbols[TRIGGER_ERROR]) {
                 return error(lexer);
             }
 
+            // The current branch is inside of a code span that can not be closed (see
+            // `parse_backtick`). Stop it right away instead of letting it run until the end of the
+            // inline content.
+            if (valid_symbols[CODE_SPAN_CLOSE] && code_span_delimiter_length == 0) {
+                return error(lexer);
+            }
+
+            // The current branch is inside of a long delimiter run that is text
+            if (state & STATE_DELIMITER_RUN_IS_TEXT) {
+                return parse_text_run(lexer, valid_symbols);
+            }
+
             // Decide which tokens to consider based on the first non-whitespace character
             switch (lexer->lookahead) {
                 case '`':
@@ -110,18 +252,22 @@ namespace TreeSitterMarkdownInline {
                     return parse_backtick(lexer, valid_symbols);
                     break;
                 case '*':
-                    // A star could either mark the beginning or ending of emphasis, a list item or
-                    // thematic break.
-                    // This code is similar to the code for '_' and '+'.
-                    return parse_star(lexer, valid_symbols);
+                    // A star could either mark the beginning or ending of emphasis.
+                    return parse_delimiter_run(lexer, valid_symbols, DELIMITER_STAR, last_token_class(valid_symbols), false);
                     break;
                 case '_':
-                    return parse_underscore(lexer, valid_symbols);
+                    return parse_delimiter_run(lexer, valid_symbols, DELIMITER_UNDERSCORE, last_token_class(valid_symbols), false);
                     break;
                 case '~':
-                    return parse_tilde(lexer, valid_symbols);
+                    return parse_delimiter_run(lexer, valid_symbols, DELIMITER_TILDE, last_token_class(valid_symbols), false);
                     break;
             }
+            if (
+                is_word_character(lexer->lookahead) && !lexer->eof(lexer) &&
+                (valid_symbols[EMPHASIS_OPEN_STAR] || valid_symbols[EMPHASIS_OPEN_UNDERSCORE] || valid_symbols[STRIKETHROUGH_OPEN])
+            ) {
+                return parse_word(lexer, valid_symbols);
+            }
             return false;
         }
 
@@ -137,182 +283,205 @@ namespace TreeSitterMarkdownInline {
                 lexer->result_symbol = CODE_SPAN_CLOSE;
                 return true;
             } else if (valid_symbols[CODE_SPAN_START]) {
-                code_span_delimiter_length = level;
+                // A run that is too long to be remembered, or that is not followed by a run of the
+                // same length, can never be closed. It still gets emitted so that the whole run is
+                // consumed and can be used as text, but a delimiter length of 0 marks the code span
+                // as unclosable.
+                bool closable = level <= MAX_DELIMITER_RUN_LENGTH && find_backtick_run(lexer, level);
+                code_span_delimiter_length = closable ? level : 0;
                 lexer->result_symbol = CODE_SPAN_START;
                 return true;
             }
             return false;
         }
 
-        bool parse_star(TSLexer *lexer, const bool *valid_symbols) {
-            lexer->advance(lexer, false);
-            // If `num_emphasis_delimiters_left` is not zero then we already decided that this should be
-            // part of an emphasis delimiter run, so interpret it as such.
-            if (num_emphasis_delimiters_left > 0) {
-                // The `STATE_EMPHASIS_DELIMITER_IS_OPEN` state flag tells us wether it should be open
-                // or close.
-                if ((state & STATE_EMPHASIS_DELIMITER_IS_OPEN) && valid_symbols[EMPHASIS_OPEN_STAR]) {
-                    state &= (~STATE_EMPHASIS_DELIMITER_IS_OPEN);
-                    lexer->result_symbol = EMPHASIS_OPEN_STAR;
-                    num_emphasis_delimiters_left--;
-                    return true;
-                } else if (valid_symbols[EMPHASIS_CLOSE_STAR]) {
-                    lexer->result_symbol = EMPHASIS_CLOSE_STAR;
-                    num_emphasis_delimiters_left--;
+        // Look ahead for a run of exactly `level` backticks. The lexer reports `eof` at the end of
+        // the inline content, so this never looks past the current inline range.
+        //
+        // Nothing is remembered between scans. A search that succeeds stops at the closing run, and
+        // the code span content in between is not searched again. A search that fails reads to the
+        // end of the range, but proves that no later run has the same length, so it happens at most
+        // once per run length on a parse branch. With at most `MAX_DELIMITER_RUN_LENGTH` lengths
+        // this bounds the lookahead for an inline range of n characters by O(255 * n).
+        //
+        // The positions of runs are not cached. `TSLexer` has no byte offset to key them by, and
+        // `get_column` reads the line again. Anything kept across scans has to go through the
+        // serialized state of a token, where a table of run lengths would be copied into every
+        // later token of the paragraph. On real documents the search reads less than one
+        // character per byte of input, so only inputs built to hit the bound would gain.
+        bool find_backtick_run(TSLexer *lexer, size_t level) {
+            size_t run_length = 0;
+            while (!lexer->eof(lexer)) {
+                if (lexer->lookahead == '`') {
+                    run_length++;
+                } else if (run_length == level) {
                     return true;
+                } else {
+                    run_length = 0;
                 }
-            }
-            lexer->mark_end(lexer);
-            // Otherwise count the number of stars
-            size_t star_count = 1;
-            while (lexer->lookahead == '*') {
-                star_count++;
                 lexer->advance(lexer, false);
             }
-            bool line_end = lexer->lookahead == '\n' || lexer->lookahead == '\r' || lexer->eof(lexer);
-            if (valid_symbols[EMPHASIS_OPEN_STAR] || valid_symbols[EMPHASIS_CLOSE_STAR]) {
-                // The desicion made for the first star also counts for all the following stars in the
-                // delimiter run. Rembemer how many there are.
-                num_emphasis_delimiters_left = star_count - 1;
-                // Look ahead to the next symbol (after the last star) to find out if it is whitespace
-                // punctuation or other.
-                bool next_symbol_whitespace = line_end || lexer->lookahead == ' ' || lexer->lookahead == '\t';
-                bool next_symbol_punctuation = is_punctuation(lexer->lookahead);
-                // Information about the last token is in valid_symbols. See grammar.js for these
-                // tokens for how this is done.
-                if (
-                    valid_symbols[EMPHASIS_CLOSE_STAR] &&
-                    !valid_symbols[LAST_TOKEN_WHITESPACE] && (
-                        !valid_symbols[LAST_TOKEN_PUNCTUATION] ||
-                        next_symbol_punctuation ||
-                        next_symbol_whitespace
-                    )
-                ) {
-                    // Closing delimiters take precedence
-                    state &= ~STATE_EMPHASIS_DELIMITER_IS_OPEN;
-                    lexer->result_symbol = EMPHASIS_CLOSE_STAR;
-                    return true;
-                } else if (
-                    !next_symbol_whitespace && (
-                        !next_symbol_punctuation ||
-                        valid_symbols[LAST_TOKEN_PUNCTUATION] ||
-                        valid_symbols[LAST_TOKEN_WHITESPACE]
-                    )
-                ) {
-                    state |= STATE_EMPHASIS_DELIMITER_IS_OPEN;
-                    lexer->result_symbol = EMPHASIS_OPEN_STAR;
-                    return true;
-                }
-            }
-            return false;
+            return run_length == level;
         }
 
-        bool parse_tilde(TSLexer *lexer, const bool *valid_symbols) {
+        // Parse a delimiter run of '*', '_' or '~'. Every character of the run is emitted as its own
+        // token, but whether the run is opening or closing is only decided once for the whole run.
+        //
+        // A run that is not used as delimiters right away is looked at again from its next
+        // character, as a new run. For runs longer than `MAX_DELIMITER_RUN_LENGTH` that would take
+        // quadratic time, so they are counted to the end once, and the length and the class of the
+        // character after them are kept in the state. If such a run can neither open nor close, it
+        // is text, see `parse_text_run`.
+        //
+        // `before` is the class of the character before the run. If `after_word` is set the run
+        // follows a word that was looked at by `parse_word`, and is only emitted if it can open but
+        // not close.
+        bool parse_delimiter_run(TSLexer *lexer, const bool *valid_symbols, const Delimiter &delimiter, CharacterClass before, bool after_word) {
             lexer->advance(lexer, false);
             // If `num_emphasis_delimiters_left` is not zero then we already decided that this should be
             // part of an emphasis delimiter run, so interpret it as such.
             if (num_emphasis_delimiters_left > 0) {
                 // The `STATE_EMPHASIS_DELIMITER_IS_OPEN` state flag tells us wether it should be open
                 // or close.
-                if ((state & STATE_EMPHASIS_DELIMITER_IS_OPEN) && valid_symbols[STRIKETHROUGH_OPEN]) {
-                    state &= (~STATE_EMPHASIS_DELIMITER_IS_OPEN);
-                    lexer->result_symbol = STRIKETHROUGH_OPEN;
+                if ((state & STATE_EMPHASIS_DELIMITER_IS_OPEN) && valid_symbols[delimiter.open]) {
+                    if (!delimiter.keep_open) {
+                        state &= (~STATE_EMPHASIS_DELIMITER_IS_OPEN);
+                    }
+                    lexer->result_symbol = delimiter.open;
                     num_emphasis_delimiters_left--;
                     return true;
-                } else if (valid_symbols[STRIKETHROUGH_CLOSE]) {
-                    lexer->result_symbol = STRIKETHROUGH_CLOSE;
+                } else if (valid_symbols[delimiter.close]) {
+                    lexer->result_symbol = delimiter.close;
                     num_emphasis_delimiters_left--;
                     return true;
                 }
             }
             lexer->mark_end(lexer);
-            // Otherwise count the number of tildes
-            size_t star_count = 1;
-            while (lexer->lookahead == '~') {
-                star_count++;
-                lexer->advance(lexer, false);
+            bool delimiter_valid = valid_symbols[delimiter.open] || valid_symbols[delimiter.close];
+            uint32_t delimiter_count = 1;
+            CharacterClass after;
+            if (num_emphasis_delimiters_left > MAX_DELIMITER_RUN_LENGTH) {
+                // The rest of a long run that was already counted
+                delimiter_count = num_emphasis_delimiters_left;
+                after = CharacterClass((state & STATE_EMPHASIS_DELIMITER_AFTER) >> STATE_EMPHASIS_DELIMITER_AFTER_SHIFT);
+            } else {
+                // Otherwise count the number of delimiters
+                while (lexer->lookahead == delimiter.character && delimiter_count <= MAX_DELIMITER_RUN_LENGTH) {
+                    delimiter_count++;
+                    lexer->advance(lexer, false);
+                }
+                if (delimiter_count > MAX_DELIMITER_RUN_LENGTH) {
+                    // Where no delimiter is valid a long run is not looked at any further.
+                    if (!delimiter_valid) {
+                        return false;
+                    }
+                    while (lexer->lookahead == delimiter.character) {
+                        delimiter_count++;
+                        lexer->advance(lexer, false);
+                    }
+                }
+                // The symbol after the last delimiter is the lookahead.
+                after = lexer->eof(lexer) ? CHARACTER_WHITESPACE : character_class(lexer->lookahead);
+                state = (state & ~STATE_EMPHASIS_DELIMITER_AFTER) | (after << STATE_EMPHASIS_DELIMITER_AFTER_SHIFT);
             }
-            bool line_end = lexer->lookahead == '\n' || lexer->lookahead == '\r' || lexer->eof(lexer);
-            if (valid_symbols[STRIKETHROUGH_OPEN] || valid_symbols[STRIKETHROUGH_CLOSE]) {
-                // The desicion made for the first star also counts for all the following stars in the
-                // delimiter run. Rembemer how many there are.
-                num_emphasis_delimiters_left = star_count - 1;
-                // Look ahead to the next symbol (after the last star) to find out if it is whitespace
-                // punctuation or other.
-                bool next_symbol_whitespace = line_end || lexer->lookahead == ' ' || lexer->lookahead == '\t';
-                bool next_symbol_punctuation = is_punctuation(lexer->lookahead);
-                // Information about the last token is in valid_symbols. See grammar.js for these
-                // tokens for how this is done.
-                if (
-                    valid_symbols[STRIKETHROUGH_CLOSE] &&
-                    !valid_symbols[LAST_TOKEN_WHITESPACE] && (
-                        !valid_symbols[LAST_TOKEN_PUNCTUATION] ||
-                        next_symbol_punctuation ||
-                        next_symbol_whitespace
-                    )
-                ) {
+            if (delimiter_valid) {
+                // The desicion made for the first delimiter also counts for all the following
+                // delimiters in the run. Rembemer how many there are.
+                num_emphasis_delimiters_left = delimiter_count - 1;
+                uint8_t rule = delimiter.rules[before][after];
+                if (after_word && (rule != DELIMITER_CAN_OPEN || !valid_symbols[delimiter.open])) {
+                    return false;
+                }
+                if (valid_symbols[delimiter.close] && (rule & DELIMITER_CAN_CLOSE)) {
                     // Closing delimiters take precedence
                     state &= ~STATE_EMPHASIS_DELIMITER_IS_OPEN;
-                    lexer->result_symbol = STRIKETHROUGH_CLOSE;
+                    lexer->result_symbol = delimiter.close;
                     return true;
-                } else if (
-                    !next_symbol_whitespace && (
-                        !next_symbol_punctuation ||
-                        valid_symbols[LAST_TOKEN_PUNCTUATION] ||
-                        valid_symbols[LAST_TOKEN_WHITESPACE]
-                    )
-                ) {
+                } else if (rule & DELIMITER_CAN_OPEN) {
                     state |= STATE_EMPHASIS_DELIMITER_IS_OPEN;
-                    lexer->result_symbol = STRIKETHROUGH_OPEN;
+                    lexer->result_symbol = delimiter.open;
                     return true;
                 }
+                if (delimiter_count > MAX_DELIMITER_RUN_LENGTH) {
+                    // A long run that can neither open nor close is text. Its first character is
+                    // consumed by the token that is valid after the whitespace or punctuation
+                    // before the run, which starts `parse_text_run`. After a word neither token is
+                    // valid, then the run is looked at again from its next character, after
+                    // punctuation.
+                    TokenType last_token =
+                        valid_symbols[LAST_TOKEN_WHITESPACE] ? LAST_TOKEN_WHITESPACE :
+                        valid_symbols[LAST_TOKEN_PUNCTUATION] ? LAST_TOKEN_PUNCTUATION :
+                        ERROR;
+                    if (last_token != ERROR) {
+                        state |= STATE_DELIMITER_RUN_IS_TEXT;
+                        lexer->result_symbol = last_token;
+                        return true;
+                    }
+                }
             }
             return false;
         }
 
+        // Continue a long delimiter run that is text, see `parse_delimiter_run`. Each character of
+        // the run is left to the grammar, which parses it as punctuation. A failed scan does not
+        // keep any state, so after every character a zero-width `$._last_token_punctuation` is
+        // emitted to count it. The grammar allows that token after every punctuation character.
+        // `num_emphasis_delimiters_left` is the number of characters of the run from the current
+        // one on.
+        bool parse_text_run(TSLexer *lexer, const bool *valid_symbols) {
+            if (!valid_symbols[LAST_TOKEN_PUNCTUATION]) {
+                // Right after the token that counted it, the current character is text.
+                return false;
+            }
+            if (num_emphasis_delimiters_left > 1) {
+                num_emphasis_delimiters_left--;
+                lexer->result_symbol = LAST_TOKEN_PUNCTUATION;
+                return true;
+            }
+            // The run ended with the last character. A delimiter run that follows right away is
+            // after punctuation, which is only known as long as the token is not emitted.
+            state &= ~STATE_DELIMITER_RUN_IS_TEXT;
+            num_emphasis_delimiters_left = 0;
+            switch (lexer->lookahead) {
+                case '*':
+                    return parse_delimiter_run(lexer, valid_symbols, DELIMITER_STAR, last_token_class(valid_symbols), false);
+                case '_':
+                    return parse_delimiter_run(lexer, valid_symbols, DELIMITER_UNDERSCORE, last_token_class(valid_symbols), false);
+                case '~':
+                    return parse_delimiter_run(lexer, valid_symbols, DELIMITER_TILDE, last_token_class(valid_symbols), false);
+            }
+            lexer->result_symbol = LAST_TOKEN_PUNCTUATION;
+            return true;
+        }
 
-        bool parse_underscore(TSLexer *lexer, const bool *valid_symbols) {
-            lexer->advance(lexer, false);
-            // If `num_emphasis_delimiters_left` is not zero then we already decided that this should be
-            // part of an emphasis delimiter run, so interpret it as such.
-            if (num_emphasis_delimiters_left > 0) {
-                // The `STATE_EMPHASIS_DELIMITER_IS_OPEN` state flag tells us wether it should be open
-                // or close.
-                if ((state & STATE_EMPHASIS_DELIMITER_IS_OPEN) && valid_symbols[EMPHASIS_OPEN_UNDERSCORE]) {
-                    lexer->result_symbol = EMPHASIS_OPEN_UNDERSCORE;
-                    num_emphasis_delimiters_left--;
-                    return true;
-                } else if (valid_symbols[EMPHASIS_CLOSE_UNDERSCORE]) {
-                    lexer->result_symbol = EMPHASIS_CLOSE_UNDERSCORE;
-                    num_emphasis_delimiters_left--;
-                    return true;
-                }
+        // Look at a word that ends right before a delimiter run. If the last character of the word
+        // is unicode whitespace or punctuation, the run has to be classified with it, which the
+        // grammar can not tell, see `last_token_class`. The word is skipped, so it becomes padding
+        // of the delimiter and no text is lost.
+        //
+        // Only runs that can open are emitted here. Where the run can close, the scan at the run
+        // itself, which sees the word as other, comes to the same decision. It may additionally
+        // find that a closing delimiter is valid only after the word. A run between unicode
+        // whitespace and whitespace can neither open nor close, but there is no token to keep the
+        // scan at the run from closing with it.
+        bool parse_word(TSLexer *lexer, const bool *valid_symbols) {
+            CharacterClass last = CHARACTER_OTHER;
+            while (is_word_character(lexer->lookahead) && !lexer->eof(lexer)) {
+                last = character_class(lexer->lookahead);
+                lexer->advance(lexer, true);
             }
-            lexer->mark_end(lexer);
-            // Otherwise count the number of stars
-            size_t underscore_count = 1;
-            while (lexer->lookahead == '_') {
-                underscore_count++;
-                lexer->advance(lexer, false);
+            if (last == CHARACTER_OTHER) {
+                return false;
             }
-            bool line_end = lexer->lookahead == '\n' || lexer->lookahead == '\r' || lexer->eof(lexer);
-            if (valid_symbols[EMPHASIS_OPEN_UNDERSCORE] || valid_symbols[EMPHASIS_CLOSE_UNDERSCORE]) {
-                num_emphasis_delimiters_left = underscore_count - 1;
-                bool next_symbol_whitespace = line_end || lexer->lookahead == ' ' || lexer->lookahead == '\t';
-                bool next_symbol_punctuation = is_punctuation(lexer->lookahead);
-                bool right_flanking = !valid_symbols[LAST_TOKEN_WHITESPACE] &&
-                    (!valid_symbols[LAST_TOKEN_PUNCTUATION] || next_symbol_punctuation || next_symbol_whitespace);
-                bool left_flanking = !next_symbol_whitespace &&
-                    (!next_symbol_punctuation || valid_symbols[LAST_TOKEN_PUNCTUATION] || valid_symbols[LAST_TOKEN_WHITESPACE]);
-                if (valid_symbols[EMPHASIS_CLOSE_UNDERSCORE] && right_flanking && (!left_flanking || next_symbol_punctuation)) {
-                    state &= ~STATE_EMPHASIS_DELIMITER_IS_OPEN;
-                    lexer->result_symbol = EMPHASIS_CLOSE_UNDERSCORE;
-                    return true;
-                } else if (left_flanking && (!right_flanking || valid_symbols[LAST_TOKEN_PUNCTUATION])) {
-                    state |= STATE_EMPHASIS_DELIMITER_IS_OPEN;
-                    lexer->result_symbol = EMPHASIS_OPEN_UNDERSCORE;
-                    return true;
-                }
+            // A run right after the word is a new one
+            num_emphasis_delimiters_left = 0;
+            switch (lexer->lookahead) {
+                case '*':
+                    return parse_delimiter_run(lexer, valid_symbols, DELIMITER_STAR, last, true);
+                case '_':
+                    return parse_delimiter_run(lexer, valid_symbols, DELIMITER_UNDERSCORE, last, true);
+                case '~':
+                    return parse_delimiter_run(lexer, valid_symbols, DELIMITER_TILDE, last, true);
             }
             return false;
         }
@@ -354,4 +523,16 @@ extern "C" {
         TreeSitterMarkdownInline::Scanner *scanner = static_cast<TreeSitterMarkdownInline::Scanner *>(payload);
         delete scanner;
     }
+
+#ifdef TREE_SITTER_MARKDOWN_STATS
+    const TSMarkdownScannerStats *tree_sitter_markdown_inline_scanner_stats(uint32_t *count) {
+        *count = TreeSitterMarkdownInline::NUM_TOKENS + 1;
+        return TreeSitterMarkdownInline::scanner_stats();
+    }
+
+    void tree_sitter_markdown_inline_scanner_stats_reset(void) {
+        using namespace TreeSitterMarkdownInline;
+        TreeSitterMarkdownStats::reset(scanner_stats(), TOKEN_NAMES, NUM_TOKENS);
+    }
+#endif
 }
@@ -1,4 +1,6 @@
 #include <tree_sitter/parser.h>
+#include "../../common/scanner.h"
+#include "../../common/stats.h"
 #include <cctype>
 #include <cassert>
 #include <vector>
@@ -62,6 +64,70 @@ enum TokenType {
     PIPE_TABLE_LINE_ENDING,
 };
 
+#ifdef TREE_SITTER_MARKDOWN_STATS
+// Names of the tokens in the order of `TokenType`
+const char *const TOKEN_NAMES[] = {
+    "LINE_ENDING",
+    "SOFT_LINE_ENDING",
+    "BLOCK_CLOSE",
+    "BLOCK_CONTINUATION",
+    "BLOCK_QUOTE_START",
+    "INDENTED_CHUNK_START",
+    "ATX_H1_MARKER",
+    "ATX_H2_MARKER",
+    "ATX_H3_MARKER",
+    "ATX_H4_MARKER",
+    "ATX_H5_MARKER",
+    "ATX_H6_MARKER",
+    "SETEXT_H1_UNDERLINE",
+    "SETEXT_H2_UNDERLINE",
+    "THEMATIC_BREAK",
+    "LIST_MARKER_MINUS",
+    "LIST_MARKER_PLUS",
+    "LIST_MARKER_STAR",
+    "LIST_MARKER_PARENTHESIS",
+    "LIST_MARKER_DOT",
+    "LIST_MARKER_MINUS_DONT_INTERRUPT",
+    "LIST_MARKER_PLUS_DONT_INTERRUPT",
+    "LIST_MARKER_STAR_DONT_INTERRUPT",
+    "LIST_MARKER_PARENTHESIS_DONT_INTERRUPT",
+    "LIST_MARKER_DOT_DONT_INTERRUPT",
+    "FENCED_CODE_BLOCK_START_BACKTICK",
+    "FENCED_CODE_BLOCK_START_TILDE",
+    "BLANK_LINE_START",
+    "FENCED_CODE_BLOCK_END_BACKTICK",
+    "FENCED_CODE_BLOCK_END_TILDE",
+    "HTML_BLOCK_1_START",
+    "HTML_BLOCK_1_END",
+    "HTML_BLOCK_2_START",
+    "HTML_BLOCK_3_START",
+    "HTML_BLOCK_4_START",
+    "HTML_BLOCK_5_START",
+    "HTML_BLOCK_6_START",
+    "HTML_BLOCK_7_START",
+    "CLOSE_BLOCK",
+    "NO_INDENTED_CHUNK",
+    "ERROR",
+    "TRIGGER_ERROR",
+    "TOKEN_EOF",
+    "MINUS_METADATA",
+    "PLUS_METADATA",
+    "PIPE_TABLE_START",
+    "PIPE_TABLE_LINE_ENDING",
+};
+const uint32_t NUM_TOKENS = sizeof(TOKEN_NAMES) / sizeof(TOKEN_NAMES[0]);
+static_assert(NUM_TOKENS == PIPE_TABLE_LINE_ENDING + 1, "Every token needs a name");
+
+// Counters of the calling thread, with an extra entry for scans without a result
+TSMarkdownScannerStats *scanner_stats() {
+    static thread_local TSMarkdownScannerStats stats[NUM_TOKENS + 1] = {};
+    if (stats[0].name == nullptr) {
+        TreeSitterMarkdownStats::reset(stats, TOKEN_NAMES, NUM_TOKENS);
+    }
+    return stats;
+}
+#endif
+
 // Description of a block on the block stack.
 //
 // LIST_ITEM is a list item with minimal indentation (content begins at indent level 2) while
@@ -92,14 +158,11 @@ enum Block : uint8_t {
     ANONYMOUS,
 };
 
-// Determines if a character is punctuation as defined by the markdown spec.
-bool is_punctuation(char c) {
-    return
-        (c >= '!' && c <= '/') ||
-        (c >= ':' && c <= '@') ||
-        (c >= '[' && c <= '`') ||
-        (c >= '{' && c <= '~');
-}
+using TreeSitterMarkdownCommon::is_punctuation;
+using TreeSitterMarkdownCommon::NUM_HTML_TAG_NAMES_RULE_1;
+using TreeSitterMarkdownCommon::HTML_TAG_NAMES_RULE_1;
+using TreeSitterMarkdownCommon::NUM_HTML_TAG_NAMES_RULE_7;
+using TreeSitterMarkdownCommon::HTML_TAG_NAMES_RULE_7;
 
 // Returns true if the block represents a list item
 bool is_list_item(Block block) {
@@ -112,18 +175,6 @@ uint8_t list_item_indentation(Block block) {
     return block - LIST_ITEM + 2;
 }
 
-const size_t NUM_HTML_TAG_NAMES_RULE_1 = 3;
-const char* HTML_TAG_NAMES_RULE_1[NUM_HTML_TAG_NAMES_RULE_1] = { "pre", "script", "style" };
-const size_t NUM_HTML_TAG_NAMES_RULE_7 = 62;
-const char* HTML_TAG_NAMES_RULE_7[NUM_HTML_TAG_NAMES_RULE_7] = {
-    "address", "article", "aside", "base", "basefont", "blockquote", "body", "caption", "center",
-    "col", "colgroup", "dd", "details", "dialog", "dir", "div", "dl", "dt", "fieldset", "figcaption",
-    "figure", "footer", "form", "frame", "frameset", "h1", "h2", "h3", "h4", "h5", "h6", "head",
-    "header", "hr", "html", "iframe", "legend", "li", "link", "main", "menu", "menuitem", "nav",
-    "noframes", "ol", "optgroup", "option", "p", "param", "section", "source", "summary", "table",
-    "tbody", "td", "tfoot", "th", "thead", "title", "tr", "track", "ul"
-};
-
 // For explanation of the tokens see grammar.js
 const bool paragraph_interrupt_symbols[] = {
     false, // LINE_ENDING,
@@ -283,6 +334,15 @@ struct Scanner {
     }
 
     bool scan(TSLexer *lexer, const bool *valid_symbols) {
+#ifdef TREE_SITTER_MARKDOWN_STATS
+        TreeSitterMarkdownStats::ScanProbe probe(scanner_stats(), NUM_TOKENS, "block", lexer, valid_symbols, simulate);
+        return probe.finish(scan_token(lexer, valid_symbols));
+#else
+        return scan_token(lexer, valid_symbols);
+#endif
+    }
+
+    bool scan_token(TSLexer *lexer, const bool *valid_symbols) {
         // A normal tree-sitter rule decided that the current branch is invalid and now "requests"
         // an error to stop the branch
         if (valid_symbols[TRIGGER_ERROR]) {
@@ -1453,4 +1513,21 @@ extern "C" {
         TreeSitterMarkdown::Scanner *scanner = static_cast<TreeSitterMarkdown::Scanner *>(payload);
         delete scanner;
     }
+
+#ifdef TREE_SITTER_MARKDOWN_STATS
+    const TSMarkdownScannerStats *tree_sitter_markdown_scanner_stats(uint32_t *count) {
+        *count = TreeSitterMarkdown::NUM_TOKENS + 1;
+        return TreeSitterMarkdown::scanner_stats();
+    }
+
+    void tree_sitter_markdown_scanner_stats_reset(void) {
+        using namespace TreeSitterMarkdown;
+        TreeSitterMarkdownStats::reset(scanner_stats(), TOKEN_NAMES, NUM_TOKENS);
+    }
+
+    // Shared by both scanners, so it is only defined here
+    void tree_sitter_markdown_scanner_trace(const TSMarkdownScanTracer *tracer) {
+        TreeSitterMarkdownStats::tracer() = tracer ? *tracer : TSMarkdownScanTracer();
+    }
+#endif
 }